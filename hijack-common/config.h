@@ -40,4 +40,172 @@
 #define CONFIG_MAX_STACK_DEPTH 127
 #endif
 
+#ifndef CONFIG_METRICS_EVENT_TYPE_MAX
+#define CONFIG_METRICS_EVENT_TYPE_MAX 16
+#endif
+
+#ifndef CONFIG_METRICS_HIST_SLOTS
+#define CONFIG_METRICS_HIST_SLOTS 32
+#endif
+
+#ifndef CONFIG_PROG_STATS_MAX
+#define CONFIG_PROG_STATS_MAX 96
+#endif
+
+#ifndef CONFIG_PROG_NAME_LEN_MAX
+#define CONFIG_PROG_NAME_LEN_MAX 48
+#endif
+
+#ifndef CONFIG_PROG_STATS_INTERVAL
+#define CONFIG_PROG_STATS_INTERVAL 5
+#endif
+
+#ifndef CONFIG_GOVERNOR_BUDGET_PPM
+#define CONFIG_GOVERNOR_BUDGET_PPM 10000
+#endif
+
+#ifndef CONFIG_GOVERNOR_SAMPLE_RATE_MAX
+#define CONFIG_GOVERNOR_SAMPLE_RATE_MAX 1024
+#endif
+
+#ifndef CONFIG_STACK_DRAIN_INTERVAL
+#define CONFIG_STACK_DRAIN_INTERVAL 1
+#endif
+
+#ifndef CONFIG_STACK_STORE_MAX
+#define CONFIG_STACK_STORE_MAX 65536
+#endif
+
+#ifndef CONFIG_STACK_SAMPLE_MAX
+#define CONFIG_STACK_SAMPLE_MAX 16384
+#endif
+
+#ifndef CONFIG_OFFCPU_AGGREGATE_MAX
+#define CONFIG_OFFCPU_AGGREGATE_MAX 10240
+#endif
+
+#ifndef CONFIG_OFFCPU_AGGREGATE_INTERVAL
+#define CONFIG_OFFCPU_AGGREGATE_INTERVAL 10
+#endif
+
+#ifndef CONFIG_OFFCPU_FOLDED_PATH
+#define CONFIG_OFFCPU_FOLDED_PATH "/var/log/hijack-offcpu.folded"
+#endif
+
+#ifndef CONFIG_FOLDED_SIZE_MAX
+#define CONFIG_FOLDED_SIZE_MAX (64 * 1024 * 1024)
+#endif
+
+#ifndef CONFIG_CGROUP_NUMBER_MAX
+#define CONFIG_CGROUP_NUMBER_MAX 1024
+#endif
+
+#ifndef CONFIG_CGROUP_PATH_LEN_MAX
+#define CONFIG_CGROUP_PATH_LEN_MAX 256
+#endif
+
+#ifndef CONFIG_ONCPU_AGGREGATE_MAX
+#define CONFIG_ONCPU_AGGREGATE_MAX 10240
+#endif
+
+#ifndef CONFIG_ONCPU_SAMPLE_FREQUENCY
+#define CONFIG_ONCPU_SAMPLE_FREQUENCY 99
+#endif
+
+#ifndef CONFIG_ONCPU_FOLDED_PATH
+#define CONFIG_ONCPU_FOLDED_PATH "/var/log/hijack-oncpu.folded"
+#endif
+
+#ifndef CONFIG_PPROF_INTERVAL
+#define CONFIG_PPROF_INTERVAL 10
+#endif
+
+#ifndef CONFIG_PPROF_PATH
+#define CONFIG_PPROF_PATH "/var/log/hijack-pprof"
+#endif
+
+#ifndef CONFIG_PPROF_SAMPLE_MAX
+#define CONFIG_PPROF_SAMPLE_MAX 10240
+#endif
+
+#ifndef CONFIG_LOG2_HIST_SLOTS
+#define CONFIG_LOG2_HIST_SLOTS 40
+#endif
+
+#ifndef CONFIG_SCHED_STATS_INTERVAL
+#define CONFIG_SCHED_STATS_INTERVAL 10
+#endif
+
+#ifndef CONFIG_CPU_ACCOUNT_TOP
+#define CONFIG_CPU_ACCOUNT_TOP 10
+#endif
+
+#ifndef CONFIG_LOCK_AGGREGATE_MAX
+#define CONFIG_LOCK_AGGREGATE_MAX 10240
+#endif
+
+#ifndef CONFIG_LOCK_TOP
+#define CONFIG_LOCK_TOP 10
+#endif
+
+#ifndef CONFIG_PAGE_FAULT_AGGREGATE_MAX
+#define CONFIG_PAGE_FAULT_AGGREGATE_MAX 10240
+#endif
+
+#ifndef CONFIG_PAGE_FAULT_FOLDED_PATH
+#define CONFIG_PAGE_FAULT_FOLDED_PATH "/var/log/hijack-page-fault.folded"
+#endif
+
+#ifndef CONFIG_GO_OFFCPU_AGGREGATE_MAX
+#define CONFIG_GO_OFFCPU_AGGREGATE_MAX 10240
+#endif
+
+#ifndef CONFIG_GO_OFFCPU_FOLDED_PATH
+#define CONFIG_GO_OFFCPU_FOLDED_PATH "/var/log/hijack-go-offcpu.folded"
+#endif
+
+#ifndef CONFIG_GO_STATS_INTERVAL
+#define CONFIG_GO_STATS_INTERVAL 10
+#endif
+
+#ifndef CONFIG_MALLOC_SAMPLE_BYTES
+#define CONFIG_MALLOC_SAMPLE_BYTES (512 * 1024)
+#endif
+
+#ifndef CONFIG_MALLOC_OUTSTANDING_MAX
+#define CONFIG_MALLOC_OUTSTANDING_MAX 65536
+#endif
+
+#ifndef CONFIG_MALLOC_STACK_MAX
+#define CONFIG_MALLOC_STACK_MAX 10240
+#endif
+
+#ifndef CONFIG_MALLOC_TOP
+#define CONFIG_MALLOC_TOP 10
+#endif
+
+#ifndef CONFIG_GO_MALLOC_SAMPLE_BYTES
+#define CONFIG_GO_MALLOC_SAMPLE_BYTES (512 * 1024)
+#endif
+
+#ifndef CONFIG_GO_MALLOC_AGGREGATE_MAX
+#define CONFIG_GO_MALLOC_AGGREGATE_MAX 10240
+#endif
+
+#ifndef CONFIG_GO_MALLOC_FOLDED_PATH
+#define CONFIG_GO_MALLOC_FOLDED_PATH "/var/log/hijack-go-malloc.folded"
+#endif
+
+#ifndef CONFIG_PYTHON_STACK_DEPTH
+#define CONFIG_PYTHON_STACK_DEPTH 32
+#endif
+
+#ifndef CONFIG_PYTHON_CODE_CACHE_MAX
+#define CONFIG_PYTHON_CODE_CACHE_MAX 65536
+#endif
+
+#ifndef CONFIG_USER_STACK_SNAPSHOT_SIZE
+#define CONFIG_USER_STACK_SNAPSHOT_SIZE 8192
+#endif
+
 #endif
@@ -13,6 +13,13 @@ enum {
 	RB_EVENT_SCHED,
 	RB_EVENT_TCP_PROBE,
 	RB_EVENT_OFFCPU_CALL_STACK,
+	RB_EVENT_USER_CALL_STACK_INLINE,
+	RB_EVENT_OFFCPU_CALL_STACK_INLINE,
+	RB_EVENT_PYTHON_CALL_STACK,
+	RB_EVENT_USER_STACK_SNAPSHOT,
+	RB_EVENT_IO_OUTLIER,
+	RB_EVENT_REQUEST_CPU,
+	RB_EVENT_MAX,
 };
 
 struct event_log {
@@ -21,6 +28,12 @@ struct event_log {
 	char msg[CONFIG_LOG_LEN_MAX];
 } __attribute__((__packed__));
 
+// 用户栈事件的来源,用户态据此决定计入 pprof 的哪一列
+enum {
+	USER_CALL_STACK_SOURCE_CUSTOMIZE,
+	USER_CALL_STACK_SOURCE_PAGE_FAULT,
+};
+
 struct event_user_call_stack {
 	unsigned int type /* = RB_EVENT_USER_CALL_STACK */;
 	unsigned long long nsec;
@@ -28,6 +41,7 @@ struct event_user_call_stack {
 	int tgid;
 	char comm[16];
 	char name[32];
+	int source /* = USER_CALL_STACK_SOURCE_* */;
 } __attribute__((__packed__));
 
 struct event_sched {
@@ -55,6 +69,99 @@ struct event_offcpu_call_stack {
 	long stackid;
 	unsigned long long duration;
 	char comm[16];
+
+	// 唤醒者的信息,没有记录到唤醒者时 waker_pid 为 0
+	int waker_tgid;
+	int waker_pid;
+	long waker_stackid;
+} __attribute__((__packed__));
+
+// 调用栈直接写在事件尾部,不经过 stack_trace_map. 事件长度可变,只上报 nr 个有效地址
+struct event_user_call_stack_inline {
+	unsigned int type /* = RB_EVENT_USER_CALL_STACK_INLINE */;
+	unsigned long long nsec;
+	int tgid;
+	char comm[16];
+	char name[32];
+	int source /* = USER_CALL_STACK_SOURCE_* */;
+	int nr;
+	unsigned long long ip[CONFIG_MAX_STACK_DEPTH];
+} __attribute__((__packed__));
+
+// Python 解释器中的一个栈帧, code 为 PyCodeObject 的地址, lasti 为当前指令在字节码中的下标,由用户态换算为行号
+struct python_frame {
+	unsigned long long code;
+	int lasti;
+} __attribute__((__packed__));
+
+// 与 event_user_call_stack_inline 同时上报,栈顶在前,只上报 nr 个有效栈帧
+struct event_python_call_stack {
+	unsigned int type /* = RB_EVENT_PYTHON_CALL_STACK */;
+	unsigned long long nsec;
+	int tgid;
+	char comm[16];
+	char name[32];
+	int nr;
+	struct python_frame frames[CONFIG_PYTHON_STACK_DEPTH];
+} __attribute__((__packed__));
+
+// 用户态寄存器和从 sp 开始的 size 字节栈内容,由用户态根据 .eh_frame 展开. 事件长度可变,只上报 size 字节
+struct event_user_stack_snapshot {
+	unsigned int type /* = RB_EVENT_USER_STACK_SNAPSHOT */;
+	unsigned long long nsec;
+	int tgid;
+	char comm[16];
+	char name[32];
+	int source /* = USER_CALL_STACK_SOURCE_* */;
+	unsigned long long ip;
+	unsigned long long sp;
+	unsigned long long bp;
+	int size;
+	unsigned char data[CONFIG_USER_STACK_SNAPSHOT_SIZE];
+} __attribute__((__packed__));
+
+// 耗时超过 pproc_cfg.io_outlier_ns 的读写类系统调用,在系统调用返回时记录. 调用栈通过 stack_trace_map 传递
+struct event_io_outlier {
+	unsigned int type /* = RB_EVENT_IO_OUTLIER */;
+	unsigned long long nsec;
+	int tgid;
+	int pid;
+	int fd;
+	int ret;
+	unsigned int i_mode;
+	unsigned long long latency;
+	long user_stackid;
+	long kernel_stackid;
+	char comm[16];
+	char name[16];
+} __attribute__((__packed__));
+
+// 服务端一次请求结束时上报,请求以 trace_id 区分,从读操作开始,到写操作之后的下一次读操作结束.
+// oncpu_ns 为处理请求的线程或协程在请求期间累计的运行时间, duration 为请求的总耗时, pid 为结束请求的线程
+struct event_request_cpu {
+	unsigned int type /* = RB_EVENT_REQUEST_CPU */;
+	unsigned long long nsec;
+	int tgid;
+	int pid;
+	unsigned long long coid;
+	unsigned long long trace_id;
+	unsigned long long oncpu_ns;
+	unsigned long long duration;
+	char comm[16];
+} __attribute__((__packed__));
+
+struct event_offcpu_call_stack_inline {
+	unsigned int type /* = RB_EVENT_OFFCPU_CALL_STACK_INLINE */;
+	unsigned long long nsec;
+	int tgid;
+	int pid;
+	unsigned long long duration;
+	char comm[16];
+	int waker_tgid;
+	int waker_pid;
+	long waker_stackid;
+	int nr;
+	unsigned long long ip[CONFIG_MAX_STACK_DEPTH];
 } __attribute__((__packed__));
 
 struct sched_switch_event {
@@ -62,8 +169,203 @@ struct sched_switch_event {
 	unsigned long long offcpu_timestamp;
 	int tgid;
 	long int prev_state;
+	long kernel_stackid;
+	int aggregate; // 切出时是否处于聚合模式
+	unsigned int weight; // 切出时采样放大的倍数,聚合时使用
+
+	// 在 sched_waking 中记录,即唤醒者的上下文,每次切出时清空
+	int waker_tgid;
+	int waker_pid;
+	long waker_stackid;
+} __attribute__((__packed__));
+
+// 内核中聚合的 offcpu 数据,由用户态定期取出并删除
+struct offcpu_aggregate_key {
+	int tgid;
+	int pid;
+	long user_stackid;
+	long kernel_stackid;
+	int waker_tgid;
+	long waker_stackid;
+} __attribute__((__packed__));
+
+struct offcpu_aggregate_value {
+	unsigned long long duration;
+	unsigned long long count;
+} __attribute__((__packed__));
+
+// 内核中聚合的以 2 为底取对数分桶的直方图,第 n 个槽位统计 [2^n, 2^(n+1)) 纳秒
+struct log2_hist {
+	unsigned long long slots[CONFIG_LOG2_HIST_SLOTS];
+	unsigned long long count;
+	unsigned long long sum;
+} __attribute__((__packed__));
+
+// 等待运行的开始时间和所属的进程、cgroup, 在被唤醒或者被抢占时记录
+struct runq_enqueue {
+	unsigned long long timestamp;
+	int tgid;
+	unsigned long long cgroup_id;
+} __attribute__((__packed__));
+
+// 锁的类型, futex 统计等待时间, pthread 锁统计持有时间
+enum {
+	LOCK_TYPE_FUTEX,
+	LOCK_TYPE_MUTEX,
+	LOCK_TYPE_RWLOCK_READ,
+	LOCK_TYPE_RWLOCK_WRITE,
+	LOCK_TYPE_MAX,
+};
+
+// 按锁的地址和等待或者加锁时的用户栈聚合, addr 为用户态地址
+struct lock_aggregate_key {
+	int tgid;
+	int type;
+	unsigned long long addr;
+	long user_stackid;
+} __attribute__((__packed__));
+
+struct lock_aggregate_value {
+	unsigned long long duration;
+	unsigned long long count;
+	unsigned long long max;
+} __attribute__((__packed__));
+
+// 协程在 runtime.gopark 中挂起的时间,按挂起原因和挂起时的用户栈聚合,值与 offcpu 相同
+struct go_offcpu_aggregate_key {
+	int tgid;
+	int reason;
+	long user_stackid;
+} __attribute__((__packed__));
+
+// 内核中聚合的页错误,值为按采样周期放大后的次数
+struct page_fault_aggregate_key {
+	int tgid;
+	long user_stackid;
+} __attribute__((__packed__));
+
+// 线程持有的 pthread 锁,加锁成功时记录,解锁时取出
+struct lock_hold_key {
+	int pid;
+	unsigned long long addr;
+} __attribute__((__packed__));
+
+struct lock_hold_value {
+	unsigned long long timestamp;
+	long user_stackid;
+	int type;
+	unsigned int weight;
+} __attribute__((__packed__));
+
+// 协程挂起时记录,被唤醒时取出. 用户态在清理 stack_trace_map 时跳过其中的 stackid
+struct go_park_value {
+	unsigned long long timestamp;
+	long user_stackid;
+	int reason;
+} __attribute__((__packed__));
+
+// 被采样的内存分配,分配时记录,释放时取出. size 为按采样周期放大后的字节数
+struct malloc_alloc_key {
+	int tgid;
+	unsigned long long ptr;
+} __attribute__((__packed__));
+
+struct malloc_alloc_value {
+	unsigned long long size;
+	long user_stackid;
+} __attribute__((__packed__));
+
+// 按分配时的用户栈聚合, outstanding 为尚未释放的字节数, total 为累计分配的字节数
+struct malloc_stack_key {
+	int tgid;
+	long user_stackid;
+} __attribute__((__packed__));
+
+struct malloc_stack_value {
+	long long outstanding;
+	unsigned long long total;
+	unsigned long long allocs;
+	unsigned long long frees;
+} __attribute__((__packed__));
+
+// Go 堆内存分配按分配时的用户栈聚合,值为按采样周期放大后的字节数和次数
+struct go_malloc_aggregate_key {
+	int tgid;
+	long user_stackid;
+} __attribute__((__packed__));
+
+struct go_malloc_aggregate_value {
+	unsigned long long bytes;
+	unsigned long long count;
+} __attribute__((__packed__));
+
+// 开启 Python 栈展开的进程,由用户态根据解释器版本填写.
+// tstate_current 为进程中保存 GIL 持有线程 PyThreadState 指针的地址,其余为结构体成员的偏移
+struct python_proc_cfg {
+	unsigned long long tstate_current;
+	unsigned int tstate_cframe;
+	unsigned int tstate_thread_id;
+	unsigned int cframe_current_frame;
+	unsigned int frame_code;
+	unsigned int frame_previous;
+	unsigned int frame_prev_instr;
+	unsigned int code_code_adaptive;
+	// 用户态符号化时使用的版本下标
+	unsigned int version;
+} __attribute__((__packed__));
+
+// 每个 CPU 上当前线程开始运行的时间. request_timestamp 为当前线程尚未计入请求的运行时间的起点,
+// 切入时与 timestamp 相同,请求结束时前移,使同一个时间片内的运行时间分别计入前后两个请求
+struct oncpu_start {
+	unsigned long long timestamp;
+	int pid;
+	unsigned long long request_timestamp;
+} __attribute__((__packed__));
+
+// 线程上一次运行所在的 CPU, 用于统计迁移次数
+struct task_last_cpu {
+	int tgid;
+	int cpu;
+} __attribute__((__packed__));
+
+struct cpu_account_key {
+	int tgid;
+	int pid;
+} __attribute__((__packed__));
+
+// 每个线程的 CPU 使用情况,在 PERCPU 的 map 中累加,用户态读取时求和
+struct cpu_account {
+	unsigned long long oncpu_ns;
+	unsigned long long voluntary;
+	unsigned long long involuntary;
+	unsigned long long migrations;
+} __attribute__((__packed__));
+
+// 内核中聚合的 oncpu 采样数据,值为采样次数
+struct oncpu_aggregate_key {
+	int tgid;
+	int pid;
+	long user_stackid;
+	long kernel_stackid;
 } __attribute__((__packed__));
 
+// governor 按功能调整采样率,功能与 eBPF 程序的对应关系见 hijack/governor.cc.
+// 系统调用的开销在于进入和退出之间必须成对维护的状态,采样无法降低,不受 governor 调整
+enum {
+	SAMPLE_FEATURE_SCHED_SWITCH,
+	SAMPLE_FEATURE_HANDLE_MM_FAULT,
+	SAMPLE_FEATURE_TCP_PROBE,
+	SAMPLE_FEATURE_PTHREAD_LOCK,
+	SAMPLE_FEATURE_MAX,
+};
+
+// stack_trace_error_map 的下标
+enum {
+	STACK_TRACE_ERROR_COLLISION,
+	STACK_TRACE_ERROR_OTHER,
+	STACK_TRACE_ERROR_MAX,
+};
+
 // 与单个进程相关的配置,至少一个功能与默认行为不一致时才会初始化,初始化时字段默认为 0,
 // io_event_socket_disabled, 默认表示不禁用 socket 的 io 事件上报
 // io_event_others_enabled, 默认表示不启用其他类型 io 事件上报
@@ -75,6 +377,18 @@ struct pproc_cfg {
 	int lock_event_enabled;
 	int handle_mm_fault_enabled;
 	int sched_switch_enabled;
+	int oncpu_sample_enabled;
+	int go_offcpu_enabled;
+	int go_sched_enabled;
+	int malloc_enabled;
+	// 平均每分配多少字节采样一次
+	unsigned int malloc_sample_bytes;
+	int go_malloc_enabled;
+	unsigned int go_malloc_sample_bytes;
+	int dwarf_unwind_enabled;
+	// 读写类系统调用耗时超过该值(纳秒)时上报调用栈,为 0 时不上报
+	unsigned long long io_outlier_ns;
+	int request_cpu_enabled;
 
 	// 保存当前进程监听的 TCP/UDP 端口号,用于判断是否是作为服务端收到了请求报文,
 	// 大多数情况下进程只会监听一个端口,这里不处理监听多个端口的情况,也不分协议处理.
@@ -89,6 +403,32 @@ struct global_cfg {
 	int sched_disabled;
 	int tcp_probe_enabled;
 	int socket_to_pid_enabled;
+
+	// 调用栈直接写入事件时的最大深度,为 0 时通过 stack_trace_map 传递 stackid
+	int call_stack_inline_depth;
+	int handle_mm_fault_inline_depth;
+	int offcpu_inline_depth;
+
+	// offcpu 在内核中按调用栈聚合,不再逐个上报事件
+	int offcpu_aggregate_enabled;
+
+	// offcpu 过滤条件,短于 offcpu_min_duration 纳秒的不上报,
+	// offcpu_state_mask 不为 0 时只记录 prev_state 与之有交集的切出,例如 2 (TASK_UNINTERRUPTIBLE) 表示只记录 D 状态
+	unsigned long long offcpu_min_duration;
+	unsigned int offcpu_state_mask;
+
+	// 至少有一个进程或者 cgroup 开启了 sched_switch_enabled, 避免没有开启时每次切换都查询配置
+	int sched_switch_scope_enabled;
+
+	// 统计从可运行到开始运行的等待时间
+	int runq_latency_enabled;
+
+	// 按线程统计运行时间、主动和被动切换次数、迁移次数
+	int cpu_account_enabled;
+
+	// 页错误在内核中按调用栈计数,每 handle_mm_fault_sample_period 次处理 1 次,为 0 或 1 时全部处理
+	int handle_mm_fault_aggregate_enabled;
+	unsigned int handle_mm_fault_sample_period;
 } __attribute__((__packed__));
 
 enum {
@@ -106,6 +446,28 @@ enum {
 	CTL_EVENT_SET_LISTEN_PORT = 11,
 	CTL_EVENT_HANDLE_MM_FAULT_ENABLED = 12,
 	CTL_EVENT_SCHED_SWITCH_EVENT_ENABLED = 13,
+	CTL_EVENT_METRICS = 14,
+	CTL_EVENT_PROG_STATS = 15,
+	CTL_EVENT_GOVERNOR = 16,
+	CTL_EVENT_CALL_STACK_INLINE_DEPTH = 17,
+	CTL_EVENT_OFFCPU_AGGREGATE_ENABLED = 18,
+	CTL_EVENT_ONCPU_SAMPLE = 19,
+	CTL_EVENT_PPROF_ENABLED = 20,
+	CTL_EVENT_OFFCPU_FILTER = 21,
+	CTL_EVENT_SCHED_SWITCH_SCOPE_ENABLED = 22,
+	CTL_EVENT_RUNQ_LATENCY_ENABLED = 23,
+	CTL_EVENT_CPU_ACCOUNT_ENABLED = 24,
+	CTL_EVENT_LOCK_EVENT_ENABLED = 25,
+	CTL_EVENT_HANDLE_MM_FAULT_AGGREGATE = 26,
+	CTL_EVENT_GO_OFFCPU_ENABLED = 27,
+	CTL_EVENT_GO_SCHED_ENABLED = 28,
+	CTL_EVENT_MALLOC_ENABLED = 29,
+	CTL_EVENT_MALLOC_REPORT = 30,
+	CTL_EVENT_GO_MALLOC_ENABLED = 31,
+	CTL_EVENT_PYTHON_UNWIND_ENABLED = 32,
+	CTL_EVENT_DWARF_UNWIND_ENABLED = 33,
+	CTL_EVENT_IO_OUTLIER = 34,
+	CTL_EVENT_REQUEST_CPU_ENABLED = 35,
 };
 
 struct ctl_io_event_others_enabled {
@@ -196,4 +558,223 @@ struct ctl_sched_switch_event_enabled {
 	int ret;
 } __attribute__((__packed__));
 
+// hijack 自身的运行指标,直方图以 2 为底取对数分桶,第 n 个槽位统计 [2^n, 2^(n+1)) 纳秒.
+// 计数均为启动以来的累计值,需要速率时由调用方间隔两次查询后根据 nsec 计算.
+struct ctl_metrics {
+	unsigned int type /* = CTL_EVENT_METRICS */;
+	unsigned long long nsec;
+
+	// 按 RB_EVENT_* 类型统计的事件数量和处理耗时
+	unsigned long long event_count[CONFIG_METRICS_EVENT_TYPE_MAX];
+	unsigned long long event_handle_ns[CONFIG_METRICS_EVENT_TYPE_MAX];
+	unsigned long long event_handle_hist[CONFIG_METRICS_EVENT_TYPE_MAX][CONFIG_METRICS_HIST_SLOTS];
+
+	// 内核产生事件到用户态开始处理的延迟
+	unsigned long long event_delay_hist[CONFIG_METRICS_HIST_SLOTS];
+
+	// 单个调用栈的符号化耗时
+	unsigned long long symbolize_hist[CONFIG_METRICS_HIST_SLOTS];
+
+	// 控制请求的处理耗时
+	unsigned long long control_hist[CONFIG_METRICS_HIST_SLOTS];
+
+	// Ringbuf 待消费的数据量,最近一次和历史最大值
+	unsigned long long ringbuf_size;
+	unsigned long long ringbuf_avail;
+	unsigned long long ringbuf_avail_max;
+
+	// stack_trace_map 定期清理的结果,见 hijack/stack_drainer.h
+	unsigned long long stack_drained;
+	unsigned long long stack_collisions;
+	unsigned long long stack_evictions;
+	unsigned long long stack_store_size;
+	unsigned long long stackid_collisions;
+	unsigned long long stackid_errors;
+
+	int ret;
+} __attribute__((__packed__));
+
+// 单个 eBPF 程序的运行统计,run_cnt 和 run_time_ns 为累计值,其余字段根据最近一个采样周期计算.
+// cpu_share_ppm 表示占整机 CPU 时间的百万分比.
+struct ctl_prog_stat {
+	char name[CONFIG_PROG_NAME_LEN_MAX];
+	unsigned long long run_cnt;
+	unsigned long long run_time_ns;
+	unsigned long long ns_per_run;
+	unsigned long long cpu_share_ppm;
+} __attribute__((__packed__));
+
+struct ctl_prog_stats {
+	unsigned int type /* = CTL_EVENT_PROG_STATS */;
+	int nr;
+	struct ctl_prog_stat stats[CONFIG_PROG_STATS_MAX];
+	int ret;
+} __attribute__((__packed__));
+
+// budget_ppm 为单个功能允许占用整机 CPU 时间的百万分比,为 0 时保持原有预算
+struct ctl_governor {
+	unsigned int type /* = CTL_EVENT_GOVERNOR */;
+	int enabled;
+	unsigned int budget_ppm;
+	int ret;
+} __attribute__((__packed__));
+
+// 各功能调用栈直接写入事件的深度,为 0 时使用 stack_trace_map, 小于 0 时保持原有配置
+struct ctl_call_stack_inline_depth {
+	unsigned int type /* = CTL_EVENT_CALL_STACK_INLINE_DEPTH */;
+	int call_stack_depth;
+	int handle_mm_fault_depth;
+	int offcpu_depth;
+	int ret;
+} __attribute__((__packed__));
+
+struct ctl_offcpu_aggregate_enabled {
+	unsigned int type /* = CTL_EVENT_OFFCPU_AGGREGATE_ENABLED */;
+	int offcpu_aggregate_enabled;
+	int ret;
+} __attribute__((__packed__));
+
+// 按进程或者 cgroup 开关 oncpu 采样, tgid 为 0 或者 cgroup 为空字符串时表示不修改对应的配置.
+// cgroup 为 cgroup v2 中的路径,不以 / 开头时视为相对于 cgroup 挂载点的路径.
+// frequency 大于 0 时以新的频率重新开始采样,小于 0 时停止采样,为 0 时保持原有频率.
+struct ctl_oncpu_sample {
+	unsigned int type /* = CTL_EVENT_ONCPU_SAMPLE */;
+	int tgid;
+	char cgroup[CONFIG_CGROUP_PATH_LEN_MAX];
+	int enabled;
+	int frequency;
+	int ret;
+} __attribute__((__packed__));
+
+struct ctl_pprof_enabled {
+	unsigned int type /* = CTL_EVENT_PPROF_ENABLED */;
+	int pprof_enabled;
+	int ret;
+} __attribute__((__packed__));
+
+struct ctl_offcpu_filter {
+	unsigned int type /* = CTL_EVENT_OFFCPU_FILTER */;
+	unsigned long long offcpu_min_duration;
+	unsigned int offcpu_state_mask;
+	int ret;
+} __attribute__((__packed__));
+
+// 按进程或者 cgroup 开启 offcpu, 其中的线程在第一次切出时自动加入 sched_switch_event_map,
+// tgid 和 cgroup 的含义与 ctl_oncpu_sample 一致
+struct ctl_sched_switch_scope_enabled {
+	unsigned int type /* = CTL_EVENT_SCHED_SWITCH_SCOPE_ENABLED */;
+	int tgid;
+	char cgroup[CONFIG_CGROUP_PATH_LEN_MAX];
+	int enabled;
+	int ret;
+} __attribute__((__packed__));
+
+struct ctl_runq_latency_enabled {
+	unsigned int type /* = CTL_EVENT_RUNQ_LATENCY_ENABLED */;
+	int runq_latency_enabled;
+	int ret;
+} __attribute__((__packed__));
+
+struct ctl_cpu_account_enabled {
+	unsigned int type /* = CTL_EVENT_CPU_ACCOUNT_ENABLED */;
+	int cpu_account_enabled;
+	int ret;
+} __attribute__((__packed__));
+
+// 按进程开启 futex 等待时间和 pthread 锁持有时间统计,需要同时通过 CTL_EVENT_PPROC_ENABLED 开启进程.
+// 开启时在进程的 libc 上挂载 pthread 锁相关的 uprobe, 关闭时卸载
+struct ctl_lock_event_enabled {
+	unsigned int type /* = CTL_EVENT_LOCK_EVENT_ENABLED */;
+	int tgid;
+	int lock_event_enabled;
+	int ret;
+} __attribute__((__packed__));
+
+// 开启后页错误不再逐个写入 Ringbuf, 定期以 folded 格式写入 CONFIG_PAGE_FAULT_FOLDED_PATH.
+// 进程依然需要通过 CTL_EVENT_HANDLE_MM_FAULT_ENABLED 开启
+struct ctl_handle_mm_fault_aggregate {
+	unsigned int type /* = CTL_EVENT_HANDLE_MM_FAULT_AGGREGATE */;
+	int enabled;
+	unsigned int sample_period;
+	int ret;
+} __attribute__((__packed__));
+
+// 按进程开启协程 offcpu, 开启时挂载 runtime.gopark 和 runtime.casgstatus 的 uprobe, 关闭时卸载
+struct ctl_go_offcpu_enabled {
+	unsigned int type /* = CTL_EVENT_GO_OFFCPU_ENABLED */;
+	int tgid;
+	int go_offcpu_enabled;
+	int ret;
+} __attribute__((__packed__));
+
+// 按进程开启协程调度延迟和协程数量统计,开启时挂载 runtime.runqput/runtime.execute/runtime.goexit1 的 uprobe, 关闭时卸载.
+// 协程数量在开启时从 runtime.allgs 读取初始值,之后由探针增减
+struct ctl_go_sched_enabled {
+	unsigned int type /* = CTL_EVENT_GO_SCHED_ENABLED */;
+	int tgid;
+	int go_sched_enabled;
+	int ret;
+} __attribute__((__packed__));
+
+// 按进程开启 malloc/calloc/realloc/free 统计,开启时挂载 libc 中的 uprobe, 关闭时卸载并清空该进程的统计.
+// 平均每分配 sample_bytes 字节采样一次,为 0 时使用 CONFIG_MALLOC_SAMPLE_BYTES
+struct ctl_malloc_enabled {
+	unsigned int type /* = CTL_EVENT_MALLOC_ENABLED */;
+	int tgid;
+	int malloc_enabled;
+	unsigned int sample_bytes;
+	int ret;
+} __attribute__((__packed__));
+
+// 主线程下次循环时打印进程中未释放字节数最多和累计分配字节数最多的前 CONFIG_MALLOC_TOP 个调用栈
+struct ctl_malloc_report {
+	unsigned int type /* = CTL_EVENT_MALLOC_REPORT */;
+	int tgid;
+	int ret;
+} __attribute__((__packed__));
+
+// 按进程开启 Go 堆内存分配统计,开启时挂载 runtime.mallocgc 的 uprobe, 关闭时卸载.
+// 平均每分配 sample_bytes 字节采样一次,为 0 时使用 CONFIG_GO_MALLOC_SAMPLE_BYTES
+struct ctl_go_malloc_enabled {
+	unsigned int type /* = CTL_EVENT_GO_MALLOC_ENABLED */;
+	int tgid;
+	int go_malloc_enabled;
+	unsigned int sample_bytes;
+	int ret;
+} __attribute__((__packed__));
+
+// 按进程开启 Python 栈展开, trace_user_call_stack 上报调用栈时同时上报 Python 解释器中的调用栈.
+// 进程中找不到支持的解释器版本时返回 -ENOTSUP
+struct ctl_python_unwind_enabled {
+	unsigned int type /* = CTL_EVENT_PYTHON_UNWIND_ENABLED */;
+	int tgid;
+	int enabled;
+	int ret;
+} __attribute__((__packed__));
+
+// 按进程开启 DWARF 栈展开, trace_user_call_stack 不再通过 bpf_get_stackid 获取调用栈,
+// 而是上报寄存器和一段用户栈,由用户态根据可执行文件的 .eh_frame 展开,适用于没有帧指针的二进制
+struct ctl_dwarf_unwind_enabled {
+	unsigned int type /* = CTL_EVENT_DWARF_UNWIND_ENABLED */;
+	int tgid;
+	int enabled;
+	int ret;
+} __attribute__((__packed__));
+
+// 设置进程的慢系统调用阈值,需要同时通过 CTL_EVENT_PPROC_ENABLED 开启进程. threshold_ns 为 0 时关闭
+struct ctl_io_outlier {
+	unsigned int type /* = CTL_EVENT_IO_OUTLIER */;
+	int tgid;
+	unsigned long long threshold_ns;
+	int ret;
+} __attribute__((__packed__));
+
+// 按进程开启请求的 CPU 耗时统计,请求以 trace_id 区分,需要同时设置监听端口并通过 CTL_EVENT_CPU_ACCOUNT_ENABLED 开启运行时间统计
+struct ctl_request_cpu_enabled {
+	unsigned int type /* = CTL_EVENT_REQUEST_CPU_ENABLED */;
+	int tgid;
+	int enabled;
+	int ret;
+} __attribute__((__packed__));
+
 #endif
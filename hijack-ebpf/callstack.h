@@ -2,16 +2,123 @@
 #ifndef HIJACK_EBPF_CALLSTACK_H
 #define HIJACK_EBPF_CALLSTACK_H
 
+#include "hijack-ebpf/maps.h"
+#include "hijack-ebpf/python.h"
 #include "hijack-ebpf/vmlinux.h"
 #include <bpf/bpf_core_read.h>
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_tracing.h>
 
-static int trace_user_call_stack(void *ctx, char *name)
+// 获取调用栈的 stackid, 失败时按原因计数.
+// 哈希桶被其他调用栈占用时返回 -EEXIST, 用户态定期清理 stack_trace_map 后才能恢复.
+static long get_stackid(void *ctx, u64 flags)
 {
+	long stackid = bpf_get_stackid(ctx, &stack_trace_map, BPF_F_FAST_STACK_CMP | flags);
+	if (stackid < 0) {
+		int idx = stackid == -17 /* EEXIST */ ? STACK_TRACE_ERROR_COLLISION : STACK_TRACE_ERROR_OTHER;
+		u64 *cnt = bpf_map_lookup_elem(&stack_trace_error_map, &idx);
+		if (cnt)
+			*cnt += 1;
+	}
+	return stackid;
+}
+
+static long get_user_stackid(void *ctx)
+{
+	return get_stackid(ctx, BPF_F_USER_STACK);
+}
+
+static long get_kernel_stackid(void *ctx)
+{
+	return get_stackid(ctx, 0);
+}
+
+// 调用栈直接写入事件,用户态不需要再查询 stack_trace_map, 也不存在 stackid 被覆盖的问题
+static int trace_user_call_stack_inline(void *ctx, char *name, int source, int depth)
+{
+	int zero = 0;
+	struct event_user_call_stack_inline *e = bpf_map_lookup_elem(&user_call_stack_inline_map, &zero);
+	if (!e)
+		return 0;
+
+	if (depth <= 0 || depth > CONFIG_MAX_STACK_DEPTH)
+		depth = CONFIG_MAX_STACK_DEPTH;
+
+	long size = bpf_get_stack(ctx, e->ip, depth * sizeof(e->ip[0]), BPF_F_USER_STACK);
+	if (size <= 0)
+		return 0;
+
+	e->type = RB_EVENT_USER_CALL_STACK_INLINE;
+	e->nsec = bpf_ktime_get_boot_ns();
+	e->tgid = bpf_get_current_pid_tgid() >> 32;
+	e->nr = size / sizeof(e->ip[0]);
+	bpf_get_current_comm(e->comm, sizeof(e->comm));
+	bpf_probe_read_kernel_str(e->name, sizeof(e->name), name);
+	e->source = source;
+
+	size += __builtin_offsetof(struct event_user_call_stack_inline, ip);
+	if (size > sizeof(*e))
+		return 0;
+
+	bpf_ringbuf_output(&ringbuf, e, size, 0);
+	return 0;
+}
+
+// 上报用户态寄存器和一段用户栈,由用户态展开. 在 kprobe 等内核态上下文中 ctx 不是用户态寄存器,统一从 task 中读取
+static int trace_user_stack_snapshot(void *ctx, char *name, int source)
+{
+	int zero = 0;
+	struct event_user_stack_snapshot *e = bpf_map_lookup_elem(&user_stack_snapshot_map, &zero);
+	if (!e)
+		return 0;
+
+	struct pt_regs *regs = (struct pt_regs *)bpf_task_pt_regs(bpf_get_current_task_btf());
+	e->ip = BPF_CORE_READ(regs, ip);
+	e->sp = BPF_CORE_READ(regs, sp);
+	e->bp = BPF_CORE_READ(regs, bp);
+
+	// 靠近栈底时超出映射范围会复制失败,缩小长度重试
+	long size = CONFIG_USER_STACK_SNAPSHOT_SIZE;
+	bool copied = false;
+	for (int idx = 0; idx < 4; ++idx) {
+		if (!bpf_probe_read_user(e->data, size, (void *)e->sp)) {
+			copied = true;
+			break;
+		}
+		size /= 2;
+	}
+	if (!copied)
+		return 0;
+
+	e->type = RB_EVENT_USER_STACK_SNAPSHOT;
+	e->nsec = bpf_ktime_get_boot_ns();
+	e->tgid = bpf_get_current_pid_tgid() >> 32;
+	e->size = size;
+	bpf_get_current_comm(e->comm, sizeof(e->comm));
+	bpf_probe_read_kernel_str(e->name, sizeof(e->name), name);
+	e->source = source;
+
+	bpf_ringbuf_output(&ringbuf, e, __builtin_offsetof(struct event_user_stack_snapshot, data) + size, 0);
+	return 0;
+}
+
+// depth 大于 0 时调用栈直接写入事件,否则通过 stack_trace_map 传递 stackid.
+// 开启了 Python 栈展开的进程同时上报解释器中的调用栈,开启了 DWARF 栈展开的进程上报栈的快照
+static int trace_user_call_stack(void *ctx, char *name, int source, int depth)
+{
+	trace_python_call_stack(ctx, name);
+
+	int tgid = bpf_get_current_pid_tgid() >> 32;
+	struct pproc_cfg *pproc_cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+	if (pproc_cfg && pproc_cfg->dwarf_unwind_enabled)
+		return trace_user_stack_snapshot(ctx, name, source);
+
+	if (depth > 0)
+		return trace_user_call_stack_inline(ctx, name, source, depth);
+
 	struct event_user_call_stack *e = (struct event_user_call_stack *)bpf_ringbuf_reserve(&ringbuf, sizeof(struct event_user_call_stack), 0);
 	if (e) {
-		e->stackid = bpf_get_stackid(ctx, &stack_trace_map, BPF_F_FAST_STACK_CMP | BPF_F_USER_STACK);
+		e->stackid = get_user_stackid(ctx);
 		if (e->stackid < 0) {
 			bpf_ringbuf_discard(e, 0);
 			return 0;
@@ -21,22 +128,34 @@ static int trace_user_call_stack(void *ctx, char *name)
 		e->tgid = bpf_get_current_pid_tgid() >> 32;
 		bpf_get_current_comm(e->comm, sizeof(e->comm));
 		bpf_probe_read_kernel_str(e->name, sizeof(e->name), name);
+		e->source = source;
 		bpf_ringbuf_submit(e, 0);
 	}
 
 	return 0;
 }
 
-static int trace_offcpu_call_stack(struct trace_event_raw_sched_switch *ctx, int tgid, int pid, unsigned long long duration, long stackid)
+// 通过控制接口手动添加的 uprobe
+static int trace_customize_call_stack(void *ctx)
+{
+	int zero = 0;
+	struct global_cfg *cfg = bpf_map_lookup_elem(&global_cfg_map, &zero);
+	return trace_user_call_stack(ctx, "customize", USER_CALL_STACK_SOURCE_CUSTOMIZE, cfg ? cfg->call_stack_inline_depth : 0);
+}
+
+static int trace_offcpu_call_stack(struct trace_event_raw_sched_switch *ctx, struct sched_switch_event *event, int pid, unsigned long long duration)
 {
 	struct event_offcpu_call_stack *e = (struct event_offcpu_call_stack *)bpf_ringbuf_reserve(&ringbuf, sizeof(struct event_offcpu_call_stack), 0);
 	if (e) {
 		e->type = RB_EVENT_OFFCPU_CALL_STACK;
 		e->nsec = bpf_ktime_get_boot_ns();
-		e->tgid = tgid;
+		e->tgid = event->tgid;
 		e->pid = pid;
 		e->duration = duration;
-		e->stackid = stackid;
+		e->stackid = event->stackid;
+		e->waker_tgid = event->waker_tgid;
+		e->waker_pid = event->waker_pid;
+		e->waker_stackid = event->waker_stackid;
 		bpf_probe_read_kernel_str(e->comm, sizeof(e->comm), ctx->next_comm);
 		bpf_ringbuf_submit(e, 0);
 	}
@@ -44,4 +163,84 @@ static int trace_offcpu_call_stack(struct trace_event_raw_sched_switch *ctx, int
 	return 0;
 }
 
+// 累加到内核中的聚合结果,用户态定期取出
+static int aggregate_offcpu_call_stack(struct sched_switch_event *event, int pid, unsigned long long duration)
+{
+	struct offcpu_aggregate_key key = {
+		.tgid = event->tgid,
+		.pid = pid,
+		.user_stackid = event->stackid,
+		.kernel_stackid = event->kernel_stackid,
+		.waker_tgid = event->waker_tgid,
+		.waker_stackid = event->waker_pid ? event->waker_stackid : -1,
+	};
+
+	struct offcpu_aggregate_value *value = bpf_map_lookup_elem(&offcpu_aggregate_map, &key);
+	if (!value) {
+		struct offcpu_aggregate_value zero = {};
+		bpf_map_update_elem(&offcpu_aggregate_map, &key, &zero, BPF_NOEXIST);
+		value = bpf_map_lookup_elem(&offcpu_aggregate_map, &key);
+		if (!value)
+			return 0;
+	}
+
+	// 按切出时的采样率放大
+	unsigned int weight = event->weight ? event->weight : 1;
+	__sync_fetch_and_add(&value->duration, duration * weight);
+	__sync_fetch_and_add(&value->count, weight);
+	return 0;
+}
+
+// 线程切出时调用,把调用栈保存到线程对应的事件中
+static int save_offcpu_call_stack_inline(struct trace_event_raw_sched_switch *ctx, int pid, int depth)
+{
+	struct event_offcpu_call_stack_inline *e = bpf_map_lookup_elem(&offcpu_call_stack_inline_map, &pid);
+	if (!e) {
+		// 事件超过 eBPF 栈的大小限制,借用临时空间创建,内容会在下面被覆盖
+		int zero = 0;
+		struct event_offcpu_call_stack_inline *scratch = bpf_map_lookup_elem(&offcpu_call_stack_inline_scratch_map, &zero);
+		if (!scratch)
+			return 0;
+		bpf_map_update_elem(&offcpu_call_stack_inline_map, &pid, scratch, BPF_NOEXIST);
+		e = bpf_map_lookup_elem(&offcpu_call_stack_inline_map, &pid);
+		if (!e)
+			return 0;
+	}
+
+	if (depth <= 0 || depth > CONFIG_MAX_STACK_DEPTH)
+		depth = CONFIG_MAX_STACK_DEPTH;
+
+	long size = bpf_get_stack(ctx, e->ip, depth * sizeof(e->ip[0]), BPF_F_USER_STACK);
+	e->nr = size > 0 ? size / sizeof(e->ip[0]) : 0;
+	return 0;
+}
+
+// 线程切入时调用,上报切出时保存的调用栈
+static int trace_offcpu_call_stack_inline(struct trace_event_raw_sched_switch *ctx, struct sched_switch_event *event, int pid, unsigned long long duration)
+{
+	struct event_offcpu_call_stack_inline *e = bpf_map_lookup_elem(&offcpu_call_stack_inline_map, &pid);
+	if (!e || e->nr <= 0 || e->nr > CONFIG_MAX_STACK_DEPTH)
+		return 0;
+
+	e->type = RB_EVENT_OFFCPU_CALL_STACK_INLINE;
+	e->nsec = bpf_ktime_get_boot_ns();
+	e->tgid = event->tgid;
+	e->pid = pid;
+	e->duration = duration;
+	e->waker_tgid = event->waker_tgid;
+	e->waker_pid = event->waker_pid;
+	e->waker_stackid = event->waker_stackid;
+	bpf_probe_read_kernel_str(e->comm, sizeof(e->comm), ctx->next_comm);
+
+	long size = __builtin_offsetof(struct event_offcpu_call_stack_inline, ip) + e->nr * sizeof(e->ip[0]);
+	if (size > sizeof(*e))
+		return 0;
+
+	bpf_ringbuf_output(&ringbuf, e, size, 0);
+
+	// 调用栈只对应一次切出,上报后清空,避免下次切出没有取到调用栈时重复上报
+	e->nr = 0;
+	return 0;
+}
+
 #endif
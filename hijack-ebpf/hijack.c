@@ -1,6 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include "hijack-ebpf/fentry.h"
 #include "hijack-ebpf/kprobe.h"
+#include "hijack-ebpf/lock.h"
+#include "hijack-ebpf/malloc.h"
+#include "hijack-ebpf/profile.h"
 #include "hijack-ebpf/sched.h"
 #include "hijack-ebpf/skb.h"
 #include "hijack-ebpf/sockops.h"
@@ -37,6 +40,31 @@ int sched_switch(struct trace_event_raw_sched_switch *ctx)
 	return trace_sched_switch(ctx);
 }
 
+SEC("tp/sched/sched_waking")
+int sched_waking(struct trace_event_raw_sched_wakeup_template *ctx)
+{
+	return trace_sched_waking(ctx);
+}
+
+SEC("tp_btf/sched_wakeup")
+int BPF_PROG(sched_wakeup, struct task_struct *p)
+{
+	return trace_sched_wakeup(p);
+}
+
+SEC("tp_btf/sched_wakeup_new")
+int BPF_PROG(sched_wakeup_new, struct task_struct *p)
+{
+	return trace_sched_wakeup(p);
+}
+
+// 由用户态通过 perf_event_open 在每个 CPU 上挂载,不随 hijack__attach 自动挂载
+SEC("perf_event")
+int oncpu_sample(struct bpf_perf_event_data *ctx)
+{
+	return trace_oncpu_sample(ctx);
+}
+
 SEC("tp/raw_syscalls/sys_enter")
 int sys_enter(struct trace_event_raw_sys_enter *ctx)
 {
@@ -143,7 +171,7 @@ int BPF_PROG(fentry_udp_lib_unhash, struct sock *sk)
 SEC("uprobe")
 int BPF_KPROBE(call_stack)
 {
-	return trace_user_call_stack(ctx, "customize");
+	return trace_customize_call_stack(ctx);
 }
 
 SEC("uprobe")
@@ -158,6 +186,174 @@ int BPF_KRETPROBE(runtime_newproc1_exit)
 	return trace_runtime_newproc1_exit(ctx);
 }
 
+SEC("uprobe")
+int BPF_KPROBE(runtime_gcbgmarkstartworkers_enter)
+{
+	return trace_runtime_gcbgmarkstartworkers_enter(ctx);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(runtime_stoptheworld_enter)
+{
+	return trace_runtime_stoptheworld_enter(ctx);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(runtime_starttheworld_enter)
+{
+	return trace_runtime_starttheworld_enter(ctx);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(runtime_runqput_enter)
+{
+	return trace_runtime_runqput_enter(ctx);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(runtime_execute_enter)
+{
+	return trace_runtime_execute_enter(ctx);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(runtime_goexit1_enter)
+{
+	return trace_runtime_goexit1_enter(ctx);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(runtime_gopark_enter)
+{
+	return trace_runtime_gopark_enter(ctx);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(runtime_casgstatus_enter)
+{
+	return trace_runtime_casgstatus_enter(ctx);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(runtime_mallocgc_enter)
+{
+	return trace_runtime_mallocgc_enter(ctx);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(pthread_mutex_lock_enter, void *mutex)
+{
+	return trace_pthread_lock_enter(ctx, (u64)mutex);
+}
+
+SEC("uretprobe")
+int BPF_KRETPROBE(pthread_mutex_lock_exit, int ret)
+{
+	return trace_pthread_lock_exit(ctx, LOCK_TYPE_MUTEX, ret);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(pthread_mutex_unlock_enter, void *mutex)
+{
+	return trace_pthread_unlock_enter(ctx, (u64)mutex);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(pthread_rwlock_rdlock_enter, void *rwlock)
+{
+	return trace_pthread_lock_enter(ctx, (u64)rwlock);
+}
+
+SEC("uretprobe")
+int BPF_KRETPROBE(pthread_rwlock_rdlock_exit, int ret)
+{
+	return trace_pthread_lock_exit(ctx, LOCK_TYPE_RWLOCK_READ, ret);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(pthread_rwlock_wrlock_enter, void *rwlock)
+{
+	return trace_pthread_lock_enter(ctx, (u64)rwlock);
+}
+
+SEC("uretprobe")
+int BPF_KRETPROBE(pthread_rwlock_wrlock_exit, int ret)
+{
+	return trace_pthread_lock_exit(ctx, LOCK_TYPE_RWLOCK_WRITE, ret);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(pthread_rwlock_unlock_enter, void *rwlock)
+{
+	return trace_pthread_unlock_enter(ctx, (u64)rwlock);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(pthread_cond_wait_enter, void *cond, void *mutex)
+{
+	return trace_pthread_cond_wait_enter(ctx, (u64)mutex);
+}
+
+SEC("uretprobe")
+int BPF_KRETPROBE(pthread_cond_wait_exit)
+{
+	return trace_pthread_cond_wait_exit(ctx);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(pthread_cond_timedwait_enter, void *cond, void *mutex)
+{
+	return trace_pthread_cond_wait_enter(ctx, (u64)mutex);
+}
+
+SEC("uretprobe")
+int BPF_KRETPROBE(pthread_cond_timedwait_exit)
+{
+	return trace_pthread_cond_wait_exit(ctx);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(malloc_enter, size_t size)
+{
+	return trace_malloc_enter(ctx, size);
+}
+
+SEC("uretprobe")
+int BPF_KRETPROBE(malloc_exit, void *ptr)
+{
+	return trace_malloc_exit(ctx, (u64)ptr);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(calloc_enter, size_t nmemb, size_t size)
+{
+	return trace_malloc_enter(ctx, (u64)nmemb * size);
+}
+
+SEC("uretprobe")
+int BPF_KRETPROBE(calloc_exit, void *ptr)
+{
+	return trace_malloc_exit(ctx, (u64)ptr);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(realloc_enter, void *ptr, size_t size)
+{
+	return trace_realloc_enter(ctx, (u64)ptr, size);
+}
+
+SEC("uretprobe")
+int BPF_KRETPROBE(realloc_exit, void *ptr)
+{
+	return trace_malloc_exit(ctx, (u64)ptr);
+}
+
+SEC("uprobe")
+int BPF_KPROBE(free_enter, void *ptr)
+{
+	return trace_free_enter(ctx, (u64)ptr);
+}
+
 SEC("uprobe")
 int BPF_KPROBE(fmt_print_enter)
 {
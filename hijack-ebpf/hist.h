@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#ifndef HIJACK_EBPF_HIST_H
+#define HIJACK_EBPF_HIST_H
+
+#include "hijack-ebpf/vmlinux.h"
+#include <bpf/bpf_helpers.h>
+
+// 不使用循环计算 floor(log2(v)), v 为 0 时返回 0
+static unsigned int log2_u64(u64 v)
+{
+	unsigned int r = 0, shift;
+
+	shift = (v > 0xffffffff) << 5;
+	v >>= shift;
+	r |= shift;
+	shift = (v > 0xffff) << 4;
+	v >>= shift;
+	r |= shift;
+	shift = (v > 0xff) << 3;
+	v >>= shift;
+	r |= shift;
+	shift = (v > 0xf) << 2;
+	v >>= shift;
+	r |= shift;
+	shift = (v > 0x3) << 1;
+	v >>= shift;
+	r |= shift;
+	r |= (v >> 1);
+	return r;
+}
+
+static void log2_hist_observe(struct log2_hist *hist, u64 value)
+{
+	unsigned int slot = log2_u64(value);
+	if (slot >= CONFIG_LOG2_HIST_SLOTS)
+		slot = CONFIG_LOG2_HIST_SLOTS - 1;
+
+	__sync_fetch_and_add(&hist->slots[slot], 1);
+	__sync_fetch_and_add(&hist->count, 1);
+	__sync_fetch_and_add(&hist->sum, value);
+}
+
+// 在 map 中查找直方图,不存在时创建后再累加
+static void log2_hist_map_observe(void *map, void *key, u64 value)
+{
+	struct log2_hist *hist = bpf_map_lookup_elem(map, key);
+	if (!hist) {
+		struct log2_hist zero = {};
+		bpf_map_update_elem(map, key, &zero, BPF_NOEXIST);
+		hist = bpf_map_lookup_elem(map, key);
+		if (!hist)
+			return;
+	}
+
+	log2_hist_observe(hist, value);
+}
+
+#endif
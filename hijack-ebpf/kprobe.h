@@ -4,6 +4,7 @@
 
 #include "hijack-ebpf/callstack.h"
 #include "hijack-ebpf/log.h"
+#include "hijack-ebpf/sample.h"
 #include "hijack-ebpf/skb.h"
 #include "hijack-ebpf/vmlinux.h"
 #include <bpf/bpf_core_read.h>
@@ -56,6 +57,34 @@ static int trace_nf_hook_slow_exit(int ret)
 	return 0;
 }
 
+// 每 period 次计数 1 次,每次累加 period, 总数依然是实际次数的估计值
+static int aggregate_handle_mm_fault(struct pt_regs *ctx, int tgid, unsigned int period)
+{
+	if (period > 1 && bpf_get_prandom_u32() % period)
+		return 0;
+
+	struct page_fault_aggregate_key key = {
+		.tgid = tgid,
+		.user_stackid = get_user_stackid(ctx),
+	};
+	// 获取调用栈失败时同样计数,统一放到 -1 下,用户态输出为 [unknown]
+	if (key.user_stackid < 0)
+		key.user_stackid = -1;
+
+	u64 delta = period > 1 ? period : 1;
+	u64 *count = bpf_map_lookup_elem(&page_fault_aggregate_map, &key);
+	if (!count) {
+		u64 zero = 0;
+		bpf_map_update_elem(&page_fault_aggregate_map, &key, &zero, BPF_NOEXIST);
+		count = bpf_map_lookup_elem(&page_fault_aggregate_map, &key);
+		if (!count)
+			return 0;
+	}
+
+	__sync_fetch_and_add(count, delta);
+	return 0;
+}
+
 static int trace_handle_mm_fault_exit(struct pt_regs *ctx, vm_fault_t ret)
 {
 	if (ret == VM_FAULT_SIGSEGV)
@@ -72,7 +101,16 @@ static int trace_handle_mm_fault_exit(struct pt_regs *ctx, vm_fault_t ret)
 	if (!cfg || !cfg->enabled || !cfg->handle_mm_fault_enabled)
 		return 0;
 
-	trace_user_call_stack(ctx, "handle_mm_fault");
+	// 聚合模式使用自己的采样周期,不受 governor 调整,保证放大后的次数准确
+	int zero = 0;
+	struct global_cfg *global_cfg = bpf_map_lookup_elem(&global_cfg_map, &zero);
+	if (global_cfg && global_cfg->handle_mm_fault_aggregate_enabled)
+		return aggregate_handle_mm_fault(ctx, tgid, global_cfg->handle_mm_fault_sample_period);
+
+	if (!sample_hit(SAMPLE_FEATURE_HANDLE_MM_FAULT))
+		return 0;
+
+	trace_user_call_stack(ctx, "handle_mm_fault", USER_CALL_STACK_SOURCE_PAGE_FAULT, global_cfg ? global_cfg->handle_mm_fault_inline_depth : 0);
 	return 0;
 }
 
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#ifndef HIJACK_EBPF_LOCK_H
+#define HIJACK_EBPF_LOCK_H
+
+#include "hijack-ebpf/callstack.h"
+#include "hijack-ebpf/maps.h"
+#include "hijack-ebpf/sample.h"
+#include "hijack-ebpf/types.h"
+#include "hijack-ebpf/vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+// 累加一次锁等待或者锁持有的时间, weight 为采样时放大的倍数,最大值不放大
+static void aggregate_lock(int tgid, int type, u64 addr, long user_stackid, u64 duration, unsigned int weight)
+{
+	struct lock_aggregate_key key = {
+		.tgid = tgid,
+		.type = type,
+		.addr = addr,
+		.user_stackid = user_stackid,
+	};
+
+	struct lock_aggregate_value *value = bpf_map_lookup_elem(&lock_aggregate_map, &key);
+	if (!value) {
+		struct lock_aggregate_value zero = {};
+		bpf_map_update_elem(&lock_aggregate_map, &key, &zero, BPF_NOEXIST);
+		value = bpf_map_lookup_elem(&lock_aggregate_map, &key);
+		if (!value)
+			return;
+	}
+
+	__sync_fetch_and_add(&value->duration, duration * weight);
+	__sync_fetch_and_add(&value->count, weight);
+	// 并发更新时最大值可能偏小,不影响排序
+	if (duration > value->max)
+		value->max = duration;
+}
+
+// 加锁前记录锁的地址,在这里采样,没有被采样的加锁不会进入 lock_hold_map, 解锁时只有一次查找
+static int trace_pthread_lock_enter(struct pt_regs *ctx, u64 addr)
+{
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	u32 tgid = (u32)(pid_tgid >> 32);
+	u32 pid = (u32)pid_tgid;
+
+	struct pproc_cfg *cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+	if (!cfg || !cfg->enabled || !cfg->lock_event_enabled)
+		return 0;
+
+	unsigned int weight = sample_weight(SAMPLE_FEATURE_PTHREAD_LOCK);
+	if (!weight)
+		return 0;
+
+	struct hook_ctx_key key = { .func = FUNC_PTHREAD_LOCK, .tgid = tgid, .pid = pid };
+	struct hook_ctx_value value = { .uaddr = addr, .weight = weight };
+	bpf_map_update_elem(&hook_ctx_map, &key, &value, BPF_ANY);
+	return 0;
+}
+
+// 加锁成功后开始计算持有时间,此时的用户栈就是加锁的位置
+static int trace_pthread_lock_exit(struct pt_regs *ctx, int type, int ret)
+{
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	u32 tgid = (u32)(pid_tgid >> 32);
+	u32 pid = (u32)pid_tgid;
+
+	struct hook_ctx_key key = { .func = FUNC_PTHREAD_LOCK, .tgid = tgid, .pid = pid };
+	struct hook_ctx_value *value = bpf_map_lookup_elem(&hook_ctx_map, &key);
+	if (!value)
+		return 0;
+
+	u64 addr = value->uaddr;
+	unsigned int weight = value->weight;
+	bpf_map_delete_elem(&hook_ctx_map, &key);
+
+	if (ret != 0)
+		return 0;
+
+	struct lock_hold_key hold_key = { .pid = pid, .addr = addr };
+	struct lock_hold_value hold_value = {
+		.timestamp = bpf_ktime_get_boot_ns(),
+		.user_stackid = get_user_stackid(ctx),
+		.type = type,
+		.weight = weight,
+	};
+	bpf_map_update_elem(&lock_hold_map, &hold_key, &hold_value, BPF_ANY);
+	return 0;
+}
+
+static int trace_pthread_unlock_enter(struct pt_regs *ctx, u64 addr)
+{
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	u32 tgid = (u32)(pid_tgid >> 32);
+	u32 pid = (u32)pid_tgid;
+
+	struct lock_hold_key key = { .pid = pid, .addr = addr };
+	struct lock_hold_value *value = bpf_map_lookup_elem(&lock_hold_map, &key);
+	if (!value)
+		return 0;
+
+	aggregate_lock(tgid, value->type, addr, value->user_stackid, bpf_ktime_get_boot_ns() - value->timestamp, value->weight);
+	bpf_map_delete_elem(&lock_hold_map, &key);
+	return 0;
+}
+
+// pthread_cond_wait 在 glibc 内部解锁和重新加锁,不经过 pthread_mutex_unlock/lock 的入口.
+// 进入时结束之前的持有,等待的时间不计入持有时间;返回时已经重新持有锁,以等待的位置重新开始计算
+static int trace_pthread_cond_wait_enter(struct pt_regs *ctx, u64 mutex)
+{
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	u32 tgid = (u32)(pid_tgid >> 32);
+	u32 pid = (u32)pid_tgid;
+
+	struct lock_hold_key hold_key = { .pid = pid, .addr = mutex };
+	struct lock_hold_value *hold_value = bpf_map_lookup_elem(&lock_hold_map, &hold_key);
+	if (!hold_value)
+		return 0;
+
+	unsigned int weight = hold_value->weight;
+	aggregate_lock(tgid, hold_value->type, mutex, hold_value->user_stackid, bpf_ktime_get_boot_ns() - hold_value->timestamp, weight);
+	bpf_map_delete_elem(&lock_hold_map, &hold_key);
+
+	struct hook_ctx_key key = { .func = FUNC_PTHREAD_COND_WAIT, .tgid = tgid, .pid = pid };
+	struct hook_ctx_value value = { .uaddr = mutex, .weight = weight };
+	bpf_map_update_elem(&hook_ctx_map, &key, &value, BPF_ANY);
+	return 0;
+}
+
+// 超时返回时同样已经重新持有锁,不区分返回值
+static int trace_pthread_cond_wait_exit(struct pt_regs *ctx)
+{
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	u32 tgid = (u32)(pid_tgid >> 32);
+	u32 pid = (u32)pid_tgid;
+
+	struct hook_ctx_key key = { .func = FUNC_PTHREAD_COND_WAIT, .tgid = tgid, .pid = pid };
+	struct hook_ctx_value *value = bpf_map_lookup_elem(&hook_ctx_map, &key);
+	if (!value)
+		return 0;
+
+	struct lock_hold_key hold_key = { .pid = pid, .addr = value->uaddr };
+	struct lock_hold_value hold_value = {
+		.timestamp = bpf_ktime_get_boot_ns(),
+		.user_stackid = get_user_stackid(ctx),
+		.type = LOCK_TYPE_MUTEX,
+		.weight = value->weight,
+	};
+	bpf_map_delete_elem(&hook_ctx_map, &key);
+	bpf_map_update_elem(&lock_hold_map, &hold_key, &hold_value, BPF_ANY);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#ifndef HIJACK_EBPF_MALLOC_H
+#define HIJACK_EBPF_MALLOC_H
+
+#include "hijack-ebpf/callstack.h"
+#include "hijack-ebpf/maps.h"
+#include "hijack-ebpf/types.h"
+#include "hijack-ebpf/vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+// 按字节采样,每个 CPU 累计分配 period 字节后采样一次,返回按采样周期放大后的字节数,没有采样时返回 0.
+// 大于 period 的分配一定会被采样,按实际大小计算
+static u64 malloc_sample(void *countdown_map, u64 size, u64 period)
+{
+	int zero = 0;
+	s64 *countdown = bpf_map_lookup_elem(countdown_map, &zero);
+	if (!countdown)
+		return 0;
+
+	*countdown -= size;
+	if (*countdown > 0)
+		return 0;
+
+	*countdown = period;
+	return size > period ? size : period;
+}
+
+// 分配前判断是否采样,被采样的分配在返回时才能拿到地址
+static int trace_malloc_enter(struct pt_regs *ctx, u64 size)
+{
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	u32 tgid = (u32)(pid_tgid >> 32);
+	u32 pid = (u32)pid_tgid;
+
+	struct pproc_cfg *cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+	if (!cfg || !cfg->enabled || !cfg->malloc_enabled)
+		return 0;
+
+	u64 weight = malloc_sample(&malloc_sample_countdown_map, size, cfg->malloc_sample_bytes ? cfg->malloc_sample_bytes : CONFIG_MALLOC_SAMPLE_BYTES);
+	if (!weight)
+		return 0;
+
+	struct hook_ctx_key key = { .func = FUNC_MALLOC, .tgid = tgid, .pid = pid };
+	struct hook_ctx_value value = { .weight = weight };
+	bpf_map_update_elem(&hook_ctx_map, &key, &value, BPF_ANY);
+	return 0;
+}
+
+// 返回时的用户栈就是调用分配函数的位置
+static int trace_malloc_exit(struct pt_regs *ctx, u64 ptr)
+{
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	u32 tgid = (u32)(pid_tgid >> 32);
+	u32 pid = (u32)pid_tgid;
+
+	struct hook_ctx_key key = { .func = FUNC_MALLOC, .tgid = tgid, .pid = pid };
+	struct hook_ctx_value *ctx_value = bpf_map_lookup_elem(&hook_ctx_map, &key);
+	if (!ctx_value)
+		return 0;
+
+	u64 weight = ctx_value->weight;
+	bpf_map_delete_elem(&hook_ctx_map, &key);
+
+	if (!ptr)
+		return 0;
+
+	struct malloc_stack_key stack_key = { .tgid = tgid, .user_stackid = get_user_stackid(ctx) };
+	struct malloc_stack_value *stack_value = bpf_map_lookup_elem(&malloc_stack_map, &stack_key);
+	if (!stack_value) {
+		struct malloc_stack_value zero = {};
+		bpf_map_update_elem(&malloc_stack_map, &stack_key, &zero, BPF_NOEXIST);
+		stack_value = bpf_map_lookup_elem(&malloc_stack_map, &stack_key);
+		if (!stack_value)
+			return 0;
+	}
+
+	__sync_fetch_and_add(&stack_value->outstanding, weight);
+	__sync_fetch_and_add(&stack_value->total, weight);
+	__sync_fetch_and_add(&stack_value->allocs, 1);
+
+	struct malloc_alloc_key alloc_key = { .tgid = tgid, .ptr = ptr };
+	struct malloc_alloc_value alloc_value = { .size = weight, .user_stackid = stack_key.user_stackid };
+	bpf_map_update_elem(&malloc_alloc_map, &alloc_key, &alloc_value, BPF_ANY);
+	return 0;
+}
+
+// 没有被采样的地址查找失败后直接返回,释放路径上只有一次查找
+static int trace_free_enter(struct pt_regs *ctx, u64 ptr)
+{
+	if (!ptr)
+		return 0;
+
+	u32 tgid = bpf_get_current_pid_tgid() >> 32;
+	struct malloc_alloc_key alloc_key = { .tgid = tgid, .ptr = ptr };
+	struct malloc_alloc_value *alloc_value = bpf_map_lookup_elem(&malloc_alloc_map, &alloc_key);
+	if (!alloc_value)
+		return 0;
+
+	struct malloc_stack_key stack_key = { .tgid = tgid, .user_stackid = alloc_value->user_stackid };
+	struct malloc_stack_value *stack_value = bpf_map_lookup_elem(&malloc_stack_map, &stack_key);
+	if (stack_value) {
+		__sync_fetch_and_add(&stack_value->outstanding, -(s64)alloc_value->size);
+		__sync_fetch_and_add(&stack_value->frees, 1);
+	}
+
+	bpf_map_delete_elem(&malloc_alloc_map, &alloc_key);
+	return 0;
+}
+
+// realloc 在进入时按释放旧地址处理,失败时旧地址依然有效,只是不再被跟踪
+static int trace_realloc_enter(struct pt_regs *ctx, u64 ptr, u64 size)
+{
+	trace_free_enter(ctx, ptr);
+	if (!size)
+		return 0;
+	return trace_malloc_enter(ctx, size);
+}
+
+// runtime.mallocgc(size uintptr, typ *_type, needzero bool), 按寄存器传参时 size 在 ax 中.
+// 只在入口采样,不使用 uretprobe, 返回时修改 Go 的栈会导致栈扩容时崩溃
+static int trace_runtime_mallocgc_enter(struct pt_regs *ctx)
+{
+	u32 tgid = bpf_get_current_pid_tgid() >> 32;
+	struct pproc_cfg *cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+	if (!cfg || !cfg->enabled || !cfg->go_malloc_enabled)
+		return 0;
+
+	u64 size = ctx->ax;
+	u64 weight = malloc_sample(&go_malloc_sample_countdown_map, size, cfg->go_malloc_sample_bytes ? cfg->go_malloc_sample_bytes : CONFIG_GO_MALLOC_SAMPLE_BYTES);
+	if (!weight)
+		return 0;
+
+	struct go_malloc_aggregate_key key = { .tgid = tgid, .user_stackid = get_user_stackid(ctx) };
+	struct go_malloc_aggregate_value *value = bpf_map_lookup_elem(&go_malloc_aggregate_map, &key);
+	if (!value) {
+		struct go_malloc_aggregate_value zero = {};
+		bpf_map_update_elem(&go_malloc_aggregate_map, &key, &zero, BPF_NOEXIST);
+		value = bpf_map_lookup_elem(&go_malloc_aggregate_map, &key);
+		if (!value)
+			return 0;
+	}
+
+	// 一次采样代表 weight / size 次分配
+	__sync_fetch_and_add(&value->bytes, weight);
+	__sync_fetch_and_add(&value->count, size ? weight / size : 1);
+	return 0;
+}
+
+#endif
@@ -48,6 +48,138 @@ struct {
 	__uint(value_size, CONFIG_MAX_STACK_DEPTH * sizeof(u64));
 } stack_trace_map SEC(".maps");
 
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_OFFCPU_AGGREGATE_MAX);
+	__type(key, struct offcpu_aggregate_key);
+	__type(value, struct offcpu_aggregate_value);
+} offcpu_aggregate_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_ONCPU_AGGREGATE_MAX);
+	__type(key, struct oncpu_aggregate_key);
+	__type(value, u64);
+} oncpu_aggregate_map SEC(".maps");
+
+// 按 cgroup 开启的功能, key 为 cgroup v2 目录的 inode 编号,与 bpf_get_current_cgroup_id 的返回值一致
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_CGROUP_NUMBER_MAX);
+	__type(key, u64);
+	__type(value, struct pproc_cfg);
+} cgroup_cfg_map SEC(".maps");
+
+// 线程数量可能远超 sched_switch_event_map, 使用 LRU 避免被唤醒后一直没有运行的线程占满
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__uint(max_entries, CONFIG_CONCURRENT_THREAD_MAX);
+	__type(key, int);
+	__type(value, struct runq_enqueue);
+} runq_enqueue_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_PROCESS_NUMBER_MAX);
+	__type(key, int);
+	__type(value, struct log2_hist);
+} runq_latency_tgid_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_CGROUP_NUMBER_MAX);
+	__type(key, u64);
+	__type(value, struct log2_hist);
+} runq_latency_cgroup_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, int);
+	__type(value, struct oncpu_start);
+} oncpu_start_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__uint(max_entries, CONFIG_CONCURRENT_THREAD_MAX);
+	__type(key, int);
+	__type(value, struct task_last_cpu);
+} task_last_cpu_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+	__uint(max_entries, CONFIG_CONCURRENT_THREAD_MAX);
+	__type(key, struct cpu_account_key);
+	__type(value, struct cpu_account);
+} cpu_account_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_PAGE_FAULT_AGGREGATE_MAX);
+	__type(key, struct page_fault_aggregate_key);
+	__type(value, u64);
+} page_fault_aggregate_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_LOCK_AGGREGATE_MAX);
+	__type(key, struct lock_aggregate_key);
+	__type(value, struct lock_aggregate_value);
+} lock_aggregate_map SEC(".maps");
+
+// 释放时没有找到的分配不会被删除,例如进程退出或者关闭统计前分配的内存,使用 LRU 自动淘汰
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__uint(max_entries, CONFIG_MALLOC_OUTSTANDING_MAX);
+	__type(key, struct malloc_alloc_key);
+	__type(value, struct malloc_alloc_value);
+} malloc_alloc_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_MALLOC_STACK_MAX);
+	__type(key, struct malloc_stack_key);
+	__type(value, struct malloc_stack_value);
+} malloc_stack_map SEC(".maps");
+
+// 每个 CPU 上距离下次采样还需要分配的字节数
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, int);
+	__type(value, s64);
+} malloc_sample_countdown_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, int);
+	__type(value, s64);
+} go_malloc_sample_countdown_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_GO_MALLOC_AGGREGATE_MAX);
+	__type(key, struct go_malloc_aggregate_key);
+	__type(value, struct go_malloc_aggregate_value);
+} go_malloc_aggregate_map SEC(".maps");
+
+// pthread_cond_wait 内部的解锁和加锁在它的入口和返回时处理. 加锁后线程退出或者通过其他方式解锁的元素不会被删除,使用 LRU 自动淘汰
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__uint(max_entries, CONFIG_CONCURRENT_THREAD_MAX);
+	__type(key, struct lock_hold_key);
+	__type(value, struct lock_hold_value);
+} lock_hold_map SEC(".maps");
+
+// bpf_get_stackid 失败次数,由用户态定期读取
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, STACK_TRACE_ERROR_MAX);
+	__type(key, int);
+	__type(value, u64);
+} stack_trace_error_map SEC(".maps");
+
 struct {
 	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
 	__uint(max_entries, 1);
@@ -69,6 +201,73 @@ struct {
 	__type(value, unsigned long long);
 } go_ancerstor_map SEC(".maps");
 
+// 协程进入运行队列的时间,以 tgid 和协程号为 key
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__uint(max_entries, CONFIG_CONCURRENT_THREAD_MAX);
+	__type(key, struct trace_object_key);
+	__type(value, u64);
+} go_runnable_map SEC(".maps");
+
+// 挂起后没有被唤醒就退出的协程不会被删除,使用 LRU 自动淘汰
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__uint(max_entries, CONFIG_CONCURRENT_THREAD_MAX);
+	__type(key, struct trace_object_key);
+	__type(value, struct go_park_value);
+} go_park_map SEC(".maps");
+
+// 以下 Go 运行时统计都以 tgid 为 key
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_PROCESS_NUMBER_MAX);
+	__type(key, int);
+	__type(value, u64);
+} go_gc_last_start_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_PROCESS_NUMBER_MAX);
+	__type(key, int);
+	__type(value, struct log2_hist);
+} go_gc_interval_hist_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_PROCESS_NUMBER_MAX);
+	__type(key, int);
+	__type(value, u64);
+} go_stw_start_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_PROCESS_NUMBER_MAX);
+	__type(key, int);
+	__type(value, struct log2_hist);
+} go_sched_latency_hist_map SEC(".maps");
+
+// 协程数量,开启时由用户态写入当前值,进入 runtime.newproc1 时加 1, 进入 runtime.goexit1 时减 1, 只使用 uprobe
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_PROCESS_NUMBER_MAX);
+	__type(key, int);
+	__type(value, s64);
+} go_goroutines_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_PROCESS_NUMBER_MAX);
+	__type(key, int);
+	__type(value, struct log2_hist);
+} go_stw_hist_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_GO_OFFCPU_AGGREGATE_MAX);
+	__type(key, struct go_offcpu_aggregate_key);
+	__type(value, struct offcpu_aggregate_value);
+} go_offcpu_aggregate_map SEC(".maps");
+
 struct {
 	__uint(type, BPF_MAP_TYPE_LRU_HASH);
 	__uint(max_entries, CONFIG_CONCURRENT_THREAD_MAX);
@@ -83,4 +282,57 @@ struct {
 	__type(value, struct sched_switch_event);
 } sched_switch_event_map SEC(".maps");
 
+// 采样率由用户态 governor 写入,单独使用一个 map 避免与控制线程同时读写 global_cfg_map
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, SAMPLE_FEATURE_MAX);
+	__type(key, int);
+	__type(value, unsigned int);
+} sample_rate_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, CONFIG_PROCESS_NUMBER_MAX);
+	__type(key, int);
+	__type(value, struct python_proc_cfg);
+} python_proc_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, int);
+	__type(value, struct event_python_call_stack);
+} python_call_stack_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, int);
+	__type(value, struct event_user_stack_snapshot);
+} user_stack_snapshot_map SEC(".maps");
+
+// 调用栈直接写入事件时使用的临时空间,事件超过 eBPF 栈的大小限制
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, int);
+	__type(value, struct event_user_call_stack_inline);
+} user_call_stack_inline_map SEC(".maps");
+
+// 线程切出时保存调用栈,切入时补全其他字段后直接作为事件上报
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+	__uint(max_entries, CONFIG_CONCURRENT_THREAD_MAX);
+	__type(key, int);
+	__type(value, struct event_offcpu_call_stack_inline);
+} offcpu_call_stack_inline_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, int);
+	__type(value, struct event_offcpu_call_stack_inline);
+} offcpu_call_stack_inline_scratch_map SEC(".maps");
+
 #endif
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#ifndef HIJACK_EBPF_PROFILE_H
+#define HIJACK_EBPF_PROFILE_H
+
+#include "hijack-ebpf/callstack.h"
+#include "hijack-ebpf/maps.h"
+#include "hijack-ebpf/vmlinux.h"
+#include <bpf/bpf_helpers.h>
+
+// 进程或者所在的 cgroup 开启了 oncpu 采样
+static bool oncpu_sample_enabled(int tgid)
+{
+	struct pproc_cfg *cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+	if (cfg && cfg->oncpu_sample_enabled)
+		return true;
+
+	u64 cgroup_id = bpf_get_current_cgroup_id();
+	cfg = bpf_map_lookup_elem(&cgroup_cfg_map, &cgroup_id);
+	return cfg && cfg->oncpu_sample_enabled;
+}
+
+// 定时采样当前 CPU 上运行的线程,按调用栈在内核中计数
+static int trace_oncpu_sample(struct bpf_perf_event_data *ctx)
+{
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	int tgid = pid_tgid >> 32;
+	int pid = (u32)pid_tgid;
+
+	// 跳过 idle 线程
+	if (!pid || !oncpu_sample_enabled(tgid))
+		return 0;
+
+	// 在用户态被采样时没有内核栈,在内核线程中被采样时没有用户栈,获取失败时用负数占位
+	struct oncpu_aggregate_key key = {
+		.tgid = tgid,
+		.pid = pid,
+		.user_stackid = get_user_stackid(ctx),
+		.kernel_stackid = get_kernel_stackid(ctx),
+	};
+
+	u64 *count = bpf_map_lookup_elem(&oncpu_aggregate_map, &key);
+	if (!count) {
+		u64 zero = 0;
+		bpf_map_update_elem(&oncpu_aggregate_map, &key, &zero, BPF_NOEXIST);
+		count = bpf_map_lookup_elem(&oncpu_aggregate_map, &key);
+		if (!count)
+			return 0;
+	}
+
+	__sync_fetch_and_add(count, 1);
+	return 0;
+}
+
+#endif
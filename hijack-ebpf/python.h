@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#ifndef HIJACK_EBPF_PYTHON_H
+#define HIJACK_EBPF_PYTHON_H
+
+#include "hijack-ebpf/maps.h"
+#include "hijack-ebpf/vmlinux.h"
+#include <bpf/bpf_core_read.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+// 从 GIL 持有线程的 PyThreadState 开始,沿 cframe->current_frame 和 frame->previous 遍历解释器栈帧.
+// 当前线程没有持有 GIL 时不上报, PyThreadState 的 thread_id 是 pthread_self(), 在 x86_64 上与 fsbase 相同
+static int trace_python_call_stack(void *ctx, char *name)
+{
+	int tgid = bpf_get_current_pid_tgid() >> 32;
+	struct python_proc_cfg *cfg = bpf_map_lookup_elem(&python_proc_map, &tgid);
+	if (!cfg)
+		return 0;
+
+	void *tstate = NULL;
+	if (bpf_probe_read_user(&tstate, sizeof(tstate), (void *)cfg->tstate_current) || !tstate)
+		return 0;
+
+	unsigned long thread_id = 0;
+	struct task_struct *task = (struct task_struct *)bpf_get_current_task();
+	unsigned long fsbase = BPF_CORE_READ(task, thread.fsbase);
+	if (bpf_probe_read_user(&thread_id, sizeof(thread_id), tstate + cfg->tstate_thread_id) || thread_id != fsbase)
+		return 0;
+
+	void *cframe = NULL;
+	void *frame = NULL;
+	if (bpf_probe_read_user(&cframe, sizeof(cframe), tstate + cfg->tstate_cframe) || !cframe)
+		return 0;
+	if (bpf_probe_read_user(&frame, sizeof(frame), cframe + cfg->cframe_current_frame) || !frame)
+		return 0;
+
+	int zero = 0;
+	struct event_python_call_stack *e = bpf_map_lookup_elem(&python_call_stack_map, &zero);
+	if (!e)
+		return 0;
+
+	int nr = 0;
+	for (int idx = 0; idx < CONFIG_PYTHON_STACK_DEPTH && frame; ++idx) {
+		u64 code = 0;
+		u64 prev_instr = 0;
+		bpf_probe_read_user(&code, sizeof(code), frame + cfg->frame_code);
+		bpf_probe_read_user(&prev_instr, sizeof(prev_instr), frame + cfg->frame_prev_instr);
+		if (!code)
+			break;
+
+		// 字节码以 2 字节为单位
+		e->frames[idx].code = code;
+		e->frames[idx].lasti = (int)((s64)(prev_instr - code - cfg->code_code_adaptive) / 2);
+		nr = idx + 1;
+
+		if (bpf_probe_read_user(&frame, sizeof(frame), frame + cfg->frame_previous))
+			break;
+	}
+	if (!nr)
+		return 0;
+
+	e->type = RB_EVENT_PYTHON_CALL_STACK;
+	e->nsec = bpf_ktime_get_boot_ns();
+	e->tgid = tgid;
+	e->nr = nr;
+	bpf_get_current_comm(e->comm, sizeof(e->comm));
+	bpf_probe_read_kernel_str(e->name, sizeof(e->name), name);
+
+	long size = __builtin_offsetof(struct event_python_call_stack, frames) + nr * sizeof(e->frames[0]);
+	if (size > sizeof(*e))
+		return 0;
+
+	bpf_ringbuf_output(&ringbuf, e, size, 0);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#ifndef HIJACK_EBPF_SAMPLE_H
+#define HIJACK_EBPF_SAMPLE_H
+
+#include "hijack-ebpf/maps.h"
+#include "hijack-ebpf/vmlinux.h"
+#include <bpf/bpf_helpers.h>
+
+// 每 rate 次触发处理 1 次,rate 为 0 或 1 时全部处理.
+// 采样只能减少判断之后的开销,程序本身的触发次数不变,所以判断要尽量放在前面.
+// 返回被采样的这一次代表的触发次数,没有被采样时返回 0, 聚合结果按返回值放大后与全部处理时的总量一致
+static unsigned int sample_weight(int feature)
+{
+	unsigned int *rate = bpf_map_lookup_elem(&sample_rate_map, &feature);
+	if (!rate || *rate <= 1)
+		return 1;
+
+	return bpf_get_prandom_u32() % *rate == 0 ? *rate : 0;
+}
+
+static bool sample_hit(int feature)
+{
+	return sample_weight(feature) != 0;
+}
+
+#endif
@@ -3,8 +3,11 @@
 #define HIJACK_EBPF_SCHED_H
 
 #include "hijack-ebpf/callstack.h"
+#include "hijack-ebpf/hist.h"
 #include "hijack-ebpf/log.h"
 #include "hijack-ebpf/maps.h"
+#include "hijack-ebpf/sample.h"
+#include "hijack-ebpf/uprobe.h"
 
 static int trace_sched_process_fork(struct trace_event_raw_sched_process_fork *ctx)
 {
@@ -64,6 +67,13 @@ static int trace_sched_process_exit(struct trace_event_raw_sched_process_templat
 
 	bpf_map_delete_elem(&pproc_cfg_map, &pid);
 	bpf_map_delete_elem(&sched_switch_event_map, &pid);
+	bpf_map_delete_elem(&offcpu_call_stack_inline_map, &pid);
+	bpf_map_delete_elem(&runq_enqueue_map, &pid);
+	bpf_map_delete_elem(&task_last_cpu_map, &pid);
+	// 只有主线程退出时 pid 与 tgid 相同
+	bpf_map_delete_elem(&go_gc_last_start_map, &pid);
+	bpf_map_delete_elem(&go_stw_start_map, &pid);
+	bpf_map_delete_elem(&go_goroutines_map, &pid);
 
 	struct event_sched *e = (struct event_sched *)bpf_ringbuf_reserve(&ringbuf, sizeof(struct event_sched), 0);
 	if (e) {
@@ -76,36 +86,251 @@ static int trace_sched_process_exit(struct trace_event_raw_sched_process_templat
 	return 0;
 }
 
+// 进程或者所在的 cgroup 开启了 sched_switch_enabled.
+// 正在退出的线程在 sched_process_exit 之后还会切出一次,不能再为它创建配置,否则 map 中的元素无法释放
+static bool sched_switch_scope_hit(int tgid)
+{
+	struct task_struct *task = (struct task_struct *)bpf_get_current_task();
+	if (BPF_CORE_READ(task, flags) & 0x00000004 /* PF_EXITING */)
+		return false;
+
+	struct pproc_cfg *cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+	if (cfg && cfg->sched_switch_enabled)
+		return true;
+
+	u64 cgroup_id = bpf_get_current_cgroup_id();
+	cfg = bpf_map_lookup_elem(&cgroup_cfg_map, &cgroup_id);
+	return cfg && cfg->sched_switch_enabled;
+}
+
+// 线程变为可运行状态,记录开始等待的时间
+static void runq_enqueue(int pid, int tgid, u64 cgroup_id)
+{
+	// 0 号线程是 idle, 不参与统计
+	if (!pid)
+		return;
+
+	struct runq_enqueue enqueue = {
+		.timestamp = bpf_ktime_get_boot_ns(),
+		.tgid = tgid,
+		.cgroup_id = cgroup_id,
+	};
+	bpf_map_update_elem(&runq_enqueue_map, &pid, &enqueue, BPF_ANY);
+}
+
+// 被唤醒的线程不是当前线程,进程号和 cgroup 从 task_struct 中读取
+static int trace_sched_wakeup(struct task_struct *p)
+{
+	int zero = 0;
+	struct global_cfg *cfg = bpf_map_lookup_elem(&global_cfg_map, &zero);
+	if (!cfg || !cfg->runq_latency_enabled)
+		return 0;
+
+	runq_enqueue(BPF_CORE_READ(p, pid), BPF_CORE_READ(p, tgid), BPF_CORE_READ(p, cgroups, dfl_cgrp, kn, id));
+	return 0;
+}
+
+// 被抢占的线程依然是可运行状态,切出时开始等待;切入时计算等待时间并累加到直方图
+static void trace_runq_latency(struct trace_event_raw_sched_switch *ctx)
+{
+	if (!(ctx->prev_state & TASK_REPORT) /* TASK_RUNNING */)
+		runq_enqueue(ctx->prev_pid, bpf_get_current_pid_tgid() >> 32, bpf_get_current_cgroup_id());
+
+	int pid = ctx->next_pid;
+	struct runq_enqueue *enqueue = bpf_map_lookup_elem(&runq_enqueue_map, &pid);
+	if (!enqueue)
+		return;
+
+	u64 latency = bpf_ktime_get_boot_ns() - enqueue->timestamp;
+	int tgid = enqueue->tgid;
+	u64 cgroup_id = enqueue->cgroup_id;
+	bpf_map_delete_elem(&runq_enqueue_map, &pid);
+
+	log2_hist_map_observe(&runq_latency_tgid_map, &tgid, latency);
+	log2_hist_map_observe(&runq_latency_cgroup_map, &cgroup_id, latency);
+}
+
+// 在 PERCPU 的 map 中查找,不存在时创建
+static struct cpu_account *lookup_cpu_account(int tgid, int pid)
+{
+	struct cpu_account_key key = {
+		.tgid = tgid,
+		.pid = pid,
+	};
+	struct cpu_account *account = bpf_map_lookup_elem(&cpu_account_map, &key);
+	if (!account) {
+		struct cpu_account zero = {};
+		bpf_map_update_elem(&cpu_account_map, &key, &zero, BPF_NOEXIST);
+		account = bpf_map_lookup_elem(&cpu_account_map, &key);
+	}
+	return account;
+}
+
+// 查找切出的线程或协程正在处理的请求,与 fetch_trace_id 使用相同的 key.
+// 协程沿 go_ancerstor_map 向上查找生成了 trace_id 的祖先协程. 同一个线程上切换协程时没有 sched_switch,
+// 时间片内的运行时间都计入切出时所在的协程
+static struct trace_object_value *lookup_request(int tgid, int pid)
+{
+	struct trace_object_key key = { .tgid = tgid };
+	u64 coid = get_current_go_routine();
+	if (coid == 0) {
+		key.pid = pid;
+		return bpf_map_lookup_elem(&trace_object_map, &key);
+	}
+
+	for (int idx = 0; idx < 16 && coid; ++idx) {
+		key.coid = coid;
+		struct trace_object_value *value = bpf_map_lookup_elem(&trace_object_map, &key);
+		if (value)
+			return value;
+		coid = get_parent_go_routine(&key);
+	}
+	return NULL;
+}
+
+// 切出的线程累加运行时间和切换次数,切入的线程在换了 CPU 时累加迁移次数.
+// 所有数据都只在当前 CPU 上修改,不需要原子操作
+static void trace_cpu_account(struct trace_event_raw_sched_switch *ctx)
+{
+	int zero = 0;
+	struct oncpu_start *start = bpf_map_lookup_elem(&oncpu_start_map, &zero);
+	if (!start)
+		return;
+
+	u64 now = bpf_ktime_get_boot_ns();
+	int cpu = bpf_get_smp_processor_id();
+
+	int pid = ctx->prev_pid;
+	if (pid) {
+		int tgid = bpf_get_current_pid_tgid() >> 32;
+		struct cpu_account *account = lookup_cpu_account(tgid, pid);
+		if (account) {
+			// 开关打开后第一次切出时没有开始时间,只统计切换次数
+			if (start->timestamp && start->pid == pid)
+				account->oncpu_ns += now - start->timestamp;
+			if (ctx->prev_state & TASK_REPORT)
+				account->voluntary += 1;
+			else
+				account->involuntary += 1;
+		}
+
+		// 请求结束时 request_timestamp 已经前移,只把剩余的部分计入当前请求. 子协程可能在其他 CPU 上同时累加
+		struct pproc_cfg *pproc_cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+		if (pproc_cfg && pproc_cfg->request_cpu_enabled && start->request_timestamp && start->pid == pid) {
+			struct trace_object_value *request = lookup_request(tgid, pid);
+			if (request)
+				__sync_fetch_and_add(&request->oncpu_ns, now - start->request_timestamp);
+		}
+
+		struct task_last_cpu last = {
+			.tgid = tgid,
+			.cpu = cpu,
+		};
+		bpf_map_update_elem(&task_last_cpu_map, &pid, &last, BPF_ANY);
+	}
+
+	pid = ctx->next_pid;
+	start->timestamp = now;
+	start->pid = pid;
+	start->request_timestamp = now;
+
+	struct task_last_cpu *last = pid ? bpf_map_lookup_elem(&task_last_cpu_map, &pid) : NULL;
+	if (last && last->cpu != cpu) {
+		struct cpu_account *account = lookup_cpu_account(last->tgid, pid);
+		if (account)
+			account->migrations += 1;
+	}
+}
+
 static int trace_sched_switch(struct trace_event_raw_sched_switch *ctx)
 {
 	int pid = 0;
+	int zero = 0;
 	unsigned long long duration = 0;
 	struct sched_switch_event *event = NULL;
+	struct global_cfg *cfg = bpf_map_lookup_elem(&global_cfg_map, &zero);
+
+	if (cfg && cfg->runq_latency_enabled)
+		trace_runq_latency(ctx);
+
+	if (cfg && cfg->cpu_account_enabled)
+		trace_cpu_account(ctx);
 
 	// offcpu
 	pid = ctx->prev_pid;
 	event = bpf_map_lookup_elem(&sched_switch_event_map, &pid);
-	if (event) {
+	if (!event && cfg && cfg->sched_switch_scope_enabled && sched_switch_scope_hit(bpf_get_current_pid_tgid() >> 32)) {
+		struct sched_switch_event empty = {};
+		bpf_map_update_elem(&sched_switch_event_map, &pid, &empty, BPF_NOEXIST);
+		event = bpf_map_lookup_elem(&sched_switch_event_map, &pid);
+	}
+
+	// 状态不匹配的切出直接跳过,不获取调用栈
+	bool state_hit = !cfg || !cfg->offcpu_state_mask || (ctx->prev_state & cfg->offcpu_state_mask);
+	unsigned int weight = event && state_hit ? sample_weight(SAMPLE_FEATURE_SCHED_SWITCH) : 0;
+	if (event && weight) {
+		event->weight = weight;
 		event->tgid = (u32)(bpf_get_current_pid_tgid() >> 32);
 		event->offcpu_timestamp = bpf_ktime_get_boot_ns();
-		event->stackid = bpf_get_stackid(ctx, &stack_trace_map, BPF_F_FAST_STACK_CMP | BPF_F_USER_STACK);
 		event->prev_state = ctx->prev_state;
+		event->waker_tgid = 0;
+		event->waker_pid = 0;
+		event->waker_stackid = -1;
+
+		if (cfg && cfg->offcpu_aggregate_enabled) {
+			// 内核栈和用户栈都只记录 stackid, 任意一个获取失败时用负数占位
+			event->aggregate = 1;
+			event->stackid = get_user_stackid(ctx);
+			event->kernel_stackid = get_kernel_stackid(ctx);
+		} else if (cfg && cfg->offcpu_inline_depth > 0) {
+			event->aggregate = 0;
+			event->stackid = 0;
+			save_offcpu_call_stack_inline(ctx, pid, cfg->offcpu_inline_depth);
+		} else {
+			event->aggregate = 0;
+			event->stackid = get_user_stackid(ctx);
+		}
 	}
 
 	// oncpu
 	pid = ctx->next_pid;
 	event = bpf_map_lookup_elem(&sched_switch_event_map, &pid);
-	if (event) {
-		if (event->offcpu_timestamp) {
-			duration = bpf_ktime_get_boot_ns() - event->offcpu_timestamp;
-		}
-		if (event->stackid > 0 && event->prev_state != 0) {
-			trace_offcpu_call_stack(ctx, event->tgid, pid, duration, event->stackid);
-		}
+	if (event && event->offcpu_timestamp) {
+		duration = bpf_ktime_get_boot_ns() - event->offcpu_timestamp;
 		event->offcpu_timestamp = 0;
+
+		// 时间过短的直接丢弃,不进入 Ringbuf 也不参与聚合
+		if (cfg && duration < cfg->offcpu_min_duration)
+			return 0;
+
+		// 切出时没有被采样的线程 offcpu_timestamp 为 0, stackid 和 prev_state 是上一次的值,不能上报
+		if (event->aggregate && event->prev_state != 0) {
+			aggregate_offcpu_call_stack(event, pid, duration);
+		} else if (event->stackid > 0 && event->prev_state != 0) {
+			trace_offcpu_call_stack(ctx, event, pid, duration);
+		} else if (event->stackid == 0 && event->prev_state != 0) {
+			trace_offcpu_call_stack_inline(ctx, event, pid, duration);
+		}
 	}
 
 	return 0;
 }
 
+// 在唤醒者的上下文中执行,为正在等待的线程记录唤醒者及其调用栈
+static int trace_sched_waking(struct trace_event_raw_sched_wakeup_template *ctx)
+{
+	int pid = ctx->pid;
+	struct sched_switch_event *event = bpf_map_lookup_elem(&sched_switch_event_map, &pid);
+
+	// 只记录切出时被采样的线程,同一次等待被多次唤醒时保留第一个唤醒者
+	if (!event || !event->offcpu_timestamp || event->waker_pid)
+		return 0;
+
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	event->waker_tgid = pid_tgid >> 32;
+	event->waker_pid = (u32)pid_tgid;
+	event->waker_stackid = get_user_stackid(ctx);
+	return 0;
+}
+
 #endif
@@ -2,8 +2,11 @@
 #ifndef HIJACK_EBPF_SYSCALLS_H
 #define HIJACK_EBPF_SYSCALLS_H
 
+#include "hijack-ebpf/callstack.h"
+#include "hijack-ebpf/lock.h"
 #include "hijack-ebpf/log.h"
 #include "hijack-ebpf/maps.h"
+#include "hijack-ebpf/sched.h"
 #include "hijack-ebpf/types.h"
 #include "hijack-ebpf/uprobe.h"
 #include "hijack-ebpf/vmlinux.h"
@@ -77,6 +80,42 @@ static bool is_read_syscall_func(enum FUNC func)
 	return false;
 }
 
+// 请求结束时先把当前时间片中已经运行的部分计入请求,再上报请求期间累计的运行时间
+static void finish_request_cpu(struct trace_object_key *key, struct trace_object_value *value)
+{
+	int zero = 0;
+	u64 now = bpf_ktime_get_boot_ns();
+	u32 pid = (u32)bpf_get_current_pid_tgid();
+
+	// 只有开启了运行时间统计时 oncpu_start_map 才会在切换时更新
+	struct global_cfg *global_cfg = bpf_map_lookup_elem(&global_cfg_map, &zero);
+	struct oncpu_start *start = bpf_map_lookup_elem(&oncpu_start_map, &zero);
+	if (global_cfg && global_cfg->cpu_account_enabled && start && start->pid == pid && start->request_timestamp) {
+		__sync_fetch_and_add(&value->oncpu_ns, now - start->request_timestamp);
+		start->request_timestamp = now;
+	}
+
+	if (value->request_started) {
+		struct event_request_cpu *e = (struct event_request_cpu *)bpf_ringbuf_reserve(&ringbuf, sizeof(struct event_request_cpu), 0);
+		if (e) {
+			e->type = RB_EVENT_REQUEST_CPU;
+			e->nsec = now;
+			e->tgid = key->tgid;
+			e->pid = pid;
+			e->coid = key->coid;
+			e->trace_id = value->trace_id;
+			e->oncpu_ns = value->oncpu_ns;
+			e->duration = now - value->request_start;
+			bpf_get_current_comm(e->comm, sizeof(e->comm));
+			bpf_ringbuf_submit(e, 0);
+		}
+	}
+
+	value->oncpu_ns = 0;
+	value->request_start = now;
+	value->request_started = 1;
+}
+
 static u64 fetch_trace_id(struct hook_ctx_key *key, struct pproc_cfg *cfg, u16 local_port)
 {
 	struct trace_object_key trace_object_key = { .tgid = key->tgid };
@@ -98,7 +137,7 @@ static u64 fetch_trace_id(struct hook_ctx_key *key, struct pproc_cfg *cfg, u16 l
 		trace_id |= ((u64)(trace_object_key.pid + trace_object_key.coid) & 0xFFFF) << 32;
 		trace_id |= ((u64)bpf_get_smp_processor_id() & 0x00FF) << 24;
 		trace_id |= ((u64)bpf_ktime_get_boot_ns() & 0xFFFF);
-		struct trace_object_value value = { .trace_id = trace_id };
+		struct trace_object_value value = { .trace_id = trace_id, .request_start = bpf_ktime_get_boot_ns() };
 		bpf_map_update_elem(&trace_object_map, &trace_object_key, &value, BPF_ANY);
 		trace_object_value = bpf_map_lookup_elem(&trace_object_map, &trace_object_key);
 	}
@@ -109,6 +148,8 @@ static u64 fetch_trace_id(struct hook_ctx_key *key, struct pproc_cfg *cfg, u16 l
 	s32 is_last_write = (trace_object_value->last_socket_operation_is_read == 0);
 	s32 is_current_read = is_read_syscall_func(key->func);
 	if (is_last_write && is_current_read && cfg->listen_port == local_port) {
+		if (cfg->request_cpu_enabled)
+			finish_request_cpu(&trace_object_key, trace_object_value);
 		++trace_object_value->trace_id;
 	}
 
@@ -117,7 +158,29 @@ static u64 fetch_trace_id(struct hook_ctx_key *key, struct pproc_cfg *cfg, u16 l
 	return trace_object_value->trace_id;
 }
 
-static void trace_io_event_common(char *label, struct pproc_cfg *cfg, struct hook_ctx_key *key, struct hook_ctx_value *value, int ret)
+// 只有超过阈值的系统调用才获取调用栈,快速返回的调用不承担获取调用栈的开销
+static void trace_io_outlier(void *ctx, char *label, struct hook_ctx_key *key, unsigned int fd, int ret, umode_t i_mode, unsigned long long latency)
+{
+	struct event_io_outlier *e = (struct event_io_outlier *)bpf_ringbuf_reserve(&ringbuf, sizeof(struct event_io_outlier), 0);
+	if (!e)
+		return;
+
+	e->type = RB_EVENT_IO_OUTLIER;
+	e->nsec = bpf_ktime_get_boot_ns();
+	e->tgid = key->tgid;
+	e->pid = key->pid;
+	e->fd = fd;
+	e->ret = ret;
+	e->i_mode = i_mode;
+	e->latency = latency;
+	e->user_stackid = get_user_stackid(ctx);
+	e->kernel_stackid = get_kernel_stackid(ctx);
+	bpf_get_current_comm(e->comm, sizeof(e->comm));
+	bpf_probe_read_kernel_str(e->name, sizeof(e->name), label);
+	bpf_ringbuf_submit(e, 0);
+}
+
+static void trace_io_event_common(void *ctx, char *label, struct pproc_cfg *cfg, struct hook_ctx_key *key, struct hook_ctx_value *value, int ret)
 {
 	if (!cfg || !key || !value)
 		return;
@@ -130,6 +193,10 @@ static void trace_io_event_common(char *label, struct pproc_cfg *cfg, struct hoo
 
 	umode_t i_mode = fd_to_i_mode(fd);
 
+	// 失败的调用同样上报,超时返回的错误往往正是要找的慢调用
+	if (cfg->io_outlier_ns && latency >= cfg->io_outlier_ns)
+		trace_io_outlier(ctx, label, key, fd, ret, i_mode, latency);
+
 	if (i_mode == S_IFSOCK && !cfg->io_event_socket_disabled) {
 		if (ret <= 0)
 			return;
@@ -145,11 +212,16 @@ static void trace_io_event_common(char *label, struct pproc_cfg *cfg, struct hoo
 			u16 remote_port = BPF_CORE_READ(sk, sk_dport);
 			remote_port = bpf_ntohs(remote_port);
 			u64 coid = get_ancestor_go_routine();
+			if (cfg->request_cpu_enabled)
+				fetch_trace_id(key, cfg, local_port);
 			LOG("%s: tgid=%d fd=%d local=%pI4:%u remote=%pI4:%u size=%d", label, tgid, fd, &local_addr, local_port, &remote_addr, remote_port, count);
 		}
 
 		if (family == AF_INET6) {
-			// TODO: 处理 IPv6
+			// TODO: 处理 IPv6 的地址. 双栈监听的服务收到的 IPv4 连接也在这里, 识别请求只需要本地端口
+			u16 local_port = BPF_CORE_READ(sk, sk_num);
+			if (cfg->request_cpu_enabled)
+				fetch_trace_id(key, cfg, local_port);
 		}
 
 		if (family == AF_UNIX) {
@@ -208,7 +280,7 @@ static int trace_sys_exit_read(struct trace_event_raw_sys_exit *ctx)
 	struct hook_ctx_key key = { .func = FUNC_SYSCALL_READ, .tgid = tgid, .pid = pid };
 	struct hook_ctx_value *value = bpf_map_lookup_elem(&hook_ctx_map, &key);
 
-	trace_io_event_common("read", cfg, &key, value, ret);
+	trace_io_event_common(ctx, "read", cfg, &key, value, ret);
 
 	bpf_map_delete_elem(&hook_ctx_map, &key);
 	return 0;
@@ -249,7 +321,7 @@ static int trace_sys_exit_write(struct trace_event_raw_sys_exit *ctx)
 	struct hook_ctx_key key = { .func = FUNC_SYSCALL_WRITE, .tgid = tgid, .pid = pid };
 	struct hook_ctx_value *value = bpf_map_lookup_elem(&hook_ctx_map, &key);
 
-	trace_io_event_common("write", cfg, &key, value, ret);
+	trace_io_event_common(ctx, "write", cfg, &key, value, ret);
 
 	bpf_map_delete_elem(&hook_ctx_map, &key);
 	return 0;
@@ -265,14 +337,14 @@ static int trace_sys_enter_futex(struct trace_event_raw_sys_enter *ctx)
 	if (!cfg || !cfg->enabled || !cfg->lock_event_enabled)
 		return 0;
 
+	// 只统计会阻塞等待的操作, WAKE/REQUEUE 等唤醒方的调用不计入
 	int futex_op = ctx->args[1] & FUTEX_CMD_MASK;
-
 	if (futex_op != FUTEX_WAIT && futex_op != FUTEX_WAIT_BITSET && futex_op != FUTEX_WAIT_REQUEUE_PI && futex_op != FUTEX_LOCK_PI &&
 	    futex_op != FUTEX_LOCK_PI2)
 		return 0;
 
 	struct hook_ctx_key key = { .func = FUNC_SYSCALL_FUTEX, .tgid = tgid, .pid = pid };
-	struct hook_ctx_value value = { .nsec = bpf_ktime_get_boot_ns() };
+	struct hook_ctx_value value = { .uaddr = ctx->args[0], .nsec = bpf_ktime_get_boot_ns() };
 	bpf_map_update_elem(&hook_ctx_map, &key, &value, BPF_ANY);
 
 	LOG("futex enter: tgid=%d pid=%d", tgid, pid);
@@ -295,9 +367,18 @@ static int trace_sys_exit_futex(struct trace_event_raw_sys_exit *ctx)
 	if (!value)
 		return 0;
 
-	LOG("futex exit: tgid=%d pid=%d", tgid, pid);
-
+	u64 duration = bpf_ktime_get_boot_ns() - value->nsec;
+	u64 uaddr = value->uaddr;
 	bpf_map_delete_elem(&hook_ctx_map, &key);
+
+	LOG("futex exit: tgid=%d pid=%d duration=%llu", tgid, pid, duration);
+
+	// 进入时锁字的值已经改变会立即返回 EAGAIN, 没有发生等待.
+	// 带超时的等待(如 pthread_cond_timedwait)超时返回 ETIMEDOUT, 等待的是条件而不是锁, 不计入锁竞争
+	if (ctx->ret == -11 /* EAGAIN */ || ctx->ret == -110 /* ETIMEDOUT */)
+		return 0;
+
+	aggregate_lock(tgid, LOCK_TYPE_FUTEX, uaddr, get_user_stackid(ctx), duration, 1);
 	return 0;
 }
 
@@ -311,6 +392,14 @@ static int trace_sys_enter_futex_waitv(struct trace_event_raw_sys_enter *ctx)
 	if (!cfg || !cfg->enabled || !cfg->lock_event_enabled)
 		return 0;
 
+	// struct futex_waitv { u64 val; u64 uaddr; u32 flags; u32 __reserved; }, 只记录第一个锁的地址
+	u64 uaddr = 0;
+	bpf_probe_read_user(&uaddr, sizeof(uaddr), (u64 *)ctx->args[0] + 1);
+
+	struct hook_ctx_key key = { .func = FUNC_SYSCALL_FUTEX_WAITV, .tgid = tgid, .pid = pid };
+	struct hook_ctx_value value = { .uaddr = uaddr, .nsec = bpf_ktime_get_boot_ns() };
+	bpf_map_update_elem(&hook_ctx_map, &key, &value, BPF_ANY);
+
 	LOG("futex_waitv enter: tgid=%d pid=%d", tgid, pid);
 	return 0;
 }
@@ -325,7 +414,22 @@ static int trace_sys_exit_futex_waitv(struct trace_event_raw_sys_exit *ctx)
 	if (!cfg || !cfg->enabled || !cfg->lock_event_enabled)
 		return 0;
 
-	LOG("futex_waitv exit: tgid=%d pid=%d", tgid, pid);
+	struct hook_ctx_key key = { .func = FUNC_SYSCALL_FUTEX_WAITV, .tgid = tgid, .pid = pid };
+	struct hook_ctx_value *value = bpf_map_lookup_elem(&hook_ctx_map, &key);
+
+	if (!value)
+		return 0;
+
+	u64 duration = bpf_ktime_get_boot_ns() - value->nsec;
+	u64 uaddr = value->uaddr;
+	bpf_map_delete_elem(&hook_ctx_map, &key);
+
+	LOG("futex_waitv exit: tgid=%d pid=%d duration=%llu", tgid, pid, duration);
+
+	if (ctx->ret == -11 /* EAGAIN */ || ctx->ret == -110 /* ETIMEDOUT */)
+		return 0;
+
+	aggregate_lock(tgid, LOCK_TYPE_FUTEX, uaddr, get_user_stackid(ctx), duration, 1);
 	return 0;
 }
 
@@ -364,7 +468,7 @@ static int trace_sys_exit_readv(struct trace_event_raw_sys_exit *ctx)
 	struct hook_ctx_key key = { .func = FUNC_SYSCALL_READV, .tgid = tgid, .pid = pid };
 	struct hook_ctx_value *value = bpf_map_lookup_elem(&hook_ctx_map, &key);
 
-	trace_io_event_common("readv", cfg, &key, value, ret);
+	trace_io_event_common(ctx, "readv", cfg, &key, value, ret);
 
 	bpf_map_delete_elem(&hook_ctx_map, &key);
 	return 0;
@@ -406,7 +510,7 @@ static int trace_sys_exit_writev(struct trace_event_raw_sys_exit *ctx)
 	struct hook_ctx_key key = { .func = FUNC_SYSCALL_WRITEV, .tgid = tgid, .pid = pid };
 	struct hook_ctx_value *value = bpf_map_lookup_elem(&hook_ctx_map, &key);
 
-	trace_io_event_common("writev", cfg, &key, value, ret);
+	trace_io_event_common(ctx, "writev", cfg, &key, value, ret);
 
 	bpf_map_delete_elem(&hook_ctx_map, &key);
 	return 0;
@@ -447,7 +551,7 @@ static int trace_sys_exit_recvfrom(struct trace_event_raw_sys_exit *ctx)
 	struct hook_ctx_key key = { .func = FUNC_SYSCALL_RECVFROM, .tgid = tgid, .pid = pid };
 	struct hook_ctx_value *value = bpf_map_lookup_elem(&hook_ctx_map, &key);
 
-	trace_io_event_common("recvfrom", cfg, &key, value, ret);
+	trace_io_event_common(ctx, "recvfrom", cfg, &key, value, ret);
 
 	bpf_map_delete_elem(&hook_ctx_map, &key);
 	return 0;
@@ -488,7 +592,7 @@ static int trace_sys_exit_recvmsg(struct trace_event_raw_sys_exit *ctx)
 	struct hook_ctx_key key = { .func = FUNC_SYSCALL_RECVMSG, .tgid = tgid, .pid = pid };
 	struct hook_ctx_value *value = bpf_map_lookup_elem(&hook_ctx_map, &key);
 
-	trace_io_event_common("recvmsg", cfg, &key, value, ret);
+	trace_io_event_common(ctx, "recvmsg", cfg, &key, value, ret);
 
 	bpf_map_delete_elem(&hook_ctx_map, &key);
 	return 0;
@@ -614,7 +718,7 @@ static int trace_sys_enter_close(struct trace_event_raw_sys_enter *ctx)
 	struct hook_ctx_value value = { .fd = fd, .nsec = bpf_ktime_get_boot_ns() };
 
 	// close 系统调用结束后 fd 相关的信息无法获取,需要在进入函数时处理
-	trace_io_event_common("close", cfg, &key, &value, 0);
+	trace_io_event_common(ctx, "close", cfg, &key, &value, 0);
 	return 0;
 }
 
@@ -653,7 +757,7 @@ static int trace_sys_exit_sendfile(struct trace_event_raw_sys_exit *ctx)
 	struct hook_ctx_key key = { .func = FUNC_SYSCALL_SENDFILE, .tgid = tgid, .pid = pid };
 	struct hook_ctx_value *value = bpf_map_lookup_elem(&hook_ctx_map, &key);
 
-	trace_io_event_common("sendfile", cfg, &key, value, ret);
+	trace_io_event_common(ctx, "sendfile", cfg, &key, value, ret);
 
 	bpf_map_delete_elem(&hook_ctx_map, &key);
 	return 0;
@@ -3,6 +3,7 @@
 #define HIJACK_EBPF_TCP_H
 
 #include "hijack-ebpf/log.h"
+#include "hijack-ebpf/sample.h"
 #include "hijack-ebpf/types.h"
 #include "hijack-ebpf/vmlinux.h"
 
@@ -116,6 +117,9 @@ static int trace_tcp_probe(struct trace_event_raw_tcp_probe *ctx)
 	if (!cfg || !cfg->tcp_probe_enabled)
 		return 0;
 
+	if (!sample_hit(SAMPLE_FEATURE_TCP_PROBE))
+		return 0;
+
 	switch (ctx->family) {
 	case AF_INET:
 		trace_ipv4_tcp_probe(ctx);
@@ -24,6 +24,9 @@ enum FUNC {
 	FUNC_SYSCALL_CLOSE,
 	FUNC_KP_NF_HOOK_SLOW,
 	FUNC_GO_RUNTIME_PROC1,
+	FUNC_PTHREAD_LOCK,
+	FUNC_PTHREAD_COND_WAIT,
+	FUNC_MALLOC,
 	FUNC_MAX,
 };
 
@@ -53,7 +56,13 @@ struct hook_ctx_value {
 
 	unsigned long long goid;
 
+	// futex 等待的用户态地址
+	unsigned long long uaddr;
+
 	unsigned long long nsec;
+
+	// 采样时放大的倍数,进入时采样,退出时按倍数累计
+	unsigned long long weight;
 } __attribute__((__packed__));
 
 // tcp probe 产生的数据量过大,根据 sock_cookie 生成一些指标后间隔一段时间上报.
@@ -78,15 +87,24 @@ struct trace_object_key {
 } __attribute__((__packed__));
 
 struct trace_object_value {
-	// 表示追踪对象最近一次 socket 操作的类型.写操作为 0, 读操作为 1.默认为 0
-	// 当发生写到读的切换时,生成新的 trace_id.
-	s32 last_socket_operation_is_read;
+	// 当前 trace_id 累计的运行时间和开始时间,开启请求的 CPU 耗时统计后才会更新.
+	// oncpu_ns 是原子操作的目标,结构体是紧凑的,必须放在 8 字节对齐的位置
+	u64 oncpu_ns;
+	u64 request_start;
 
 	// 以系统调用为基本单位,生成用于追踪的 id
 	u64 trace_id;
 
+	// 表示追踪对象最近一次 socket 操作的类型.写操作为 0, 读操作为 1.默认为 0
+	// 当发生写到读的切换时,生成新的 trace_id.
+	s32 last_socket_operation_is_read;
+
+	// 表示当前 trace_id 由读操作开始,建立连接到第一次读之间的部分不作为请求上报
+	s32 request_started;
 } __attribute__((__packed__));
 
+_Static_assert(__builtin_offsetof(struct trace_object_value, oncpu_ns) % 8 == 0, "oncpu_ns must be 8-byte aligned for atomic add");
+
 #define S_IFMT 00170000
 #define S_IFSOCK 0140000
 #define S_IFLNK 0120000
@@ -107,6 +125,9 @@ struct trace_object_value {
 #define S_ISFIFO(m) (((m)&S_IFMT) == S_IFIFO)
 #define S_ISSOCK(m) (((m)&S_IFMT) == S_IFSOCK)
 
+// sched_switch 的 prev_state 只有低位是任务状态, 被抢占的任务从 4.14 开始报告为 TASK_REPORT_MAX(0x100) 而不是 0
+#define TASK_REPORT 0xff
+
 #define FUTEX_WAIT 0
 #define FUTEX_LOCK_PI 6
 #define FUTEX_WAIT_BITSET 9
@@ -3,6 +3,7 @@
 #define HIJACK_EBPF_UPROBE_H
 
 #include "hijack-ebpf/callstack.h"
+#include "hijack-ebpf/hist.h"
 #include "hijack-ebpf/log.h"
 #include "hijack-ebpf/skb.h"
 #include "hijack-ebpf/vmlinux.h"
@@ -72,6 +73,19 @@ static u64 get_ancestor_go_routine(void)
 	return current;
 }
 
+static void add_go_goroutines(int tgid, s64 delta)
+{
+	s64 *count = bpf_map_lookup_elem(&go_goroutines_map, &tgid);
+	if (!count) {
+		s64 zero = 0;
+		bpf_map_update_elem(&go_goroutines_map, &tgid, &zero, BPF_NOEXIST);
+		count = bpf_map_lookup_elem(&go_goroutines_map, &tgid);
+		if (!count)
+			return;
+	}
+	__sync_fetch_and_add(count, delta);
+}
+
 static int trace_runtime_newproc1_enter(struct pt_regs *ctx)
 {
 	u64 pid_tgid = bpf_get_current_pid_tgid();
@@ -82,6 +96,10 @@ static int trace_runtime_newproc1_enter(struct pt_regs *ctx)
 	if (!cfg || !cfg->enabled)
 		return 0;
 
+	// newproc1 失败时直接抛出异常,进入即可计数,不依赖可能导致进程崩溃的 uretprobe
+	if (cfg->go_sched_enabled)
+		add_go_goroutines(tgid, 1);
+
 	void *g = (void *)ctx->bx;
 	u64 parent = get_goid_from_g(g);
 	if (parent == 0)
@@ -326,4 +344,158 @@ static int trace_golang_org_x_net_http2_Framer_WriteDataPadded(struct pt_regs *c
 	return 0;
 }
 
+// func gopark(unlockf func(*g, unsafe.Pointer) bool, lock unsafe.Pointer, reason waitReason, ...)
+// 在协程自己的栈上执行,用户栈就是协程挂起的位置,挂起原因是第三个参数
+static int trace_runtime_gopark_enter(struct pt_regs *ctx)
+{
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	u32 tgid = (u32)(pid_tgid >> 32);
+
+	struct pproc_cfg *cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+	if (!cfg || !cfg->enabled || !cfg->go_offcpu_enabled)
+		return 0;
+
+	u64 goid = get_current_go_routine();
+	if (goid == 0)
+		return 0;
+
+	struct trace_object_key key = { .tgid = tgid, .coid = goid };
+	struct go_park_value value = {
+		.timestamp = bpf_ktime_get_boot_ns(),
+		.user_stackid = get_user_stackid(ctx),
+		.reason = (u8)ctx->cx,
+	};
+	bpf_map_update_elem(&go_park_map, &key, &value, BPF_ANY);
+	return 0;
+}
+
+// func casgstatus(gp *g, oldval, newval uint32)
+// channel 等通过 goready 唤醒, netpoll 通过 injectglist 唤醒,最终都会把协程状态从 _Gwaiting 改为 _Grunnable
+static int trace_runtime_casgstatus_enter(struct pt_regs *ctx)
+{
+	if ((u32)ctx->bx != 4 /* _Gwaiting */ || (u32)ctx->cx != 1 /* _Grunnable */)
+		return 0;
+
+	u64 pid_tgid = bpf_get_current_pid_tgid();
+	u32 tgid = (u32)(pid_tgid >> 32);
+
+	u64 goid = get_goid_from_g((void *)ctx->ax);
+	struct trace_object_key key = { .tgid = tgid, .coid = goid };
+	struct go_park_value *value = bpf_map_lookup_elem(&go_park_map, &key);
+	if (!value)
+		return 0;
+
+	struct go_offcpu_aggregate_key aggregate_key = {
+		.tgid = tgid,
+		.reason = value->reason,
+		.user_stackid = value->user_stackid,
+	};
+	u64 duration = bpf_ktime_get_boot_ns() - value->timestamp;
+	bpf_map_delete_elem(&go_park_map, &key);
+
+	struct offcpu_aggregate_value *aggregate = bpf_map_lookup_elem(&go_offcpu_aggregate_map, &aggregate_key);
+	if (!aggregate) {
+		struct offcpu_aggregate_value zero = {};
+		bpf_map_update_elem(&go_offcpu_aggregate_map, &aggregate_key, &zero, BPF_NOEXIST);
+		aggregate = bpf_map_lookup_elem(&go_offcpu_aggregate_map, &aggregate_key);
+		if (!aggregate)
+			return 0;
+	}
+
+	__sync_fetch_and_add(&aggregate->duration, duration);
+	__sync_fetch_and_add(&aggregate->count, 1);
+	return 0;
+}
+
+// 两次 GC 开始的间隔,直方图的 count 就是这段时间内 GC 的次数.
+// runtime.gcStart 在触发条件不满足时直接返回,并发触发时会多次进入;
+// gcBgMarkStartWorkers 只在 gcStart 通过触发检查、确实开始新一轮 GC 后调用,每轮一次
+static int trace_runtime_gcbgmarkstartworkers_enter(struct pt_regs *ctx)
+{
+	int tgid = bpf_get_current_pid_tgid() >> 32;
+
+	struct pproc_cfg *cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+	if (!cfg || !cfg->enabled)
+		return 0;
+
+	u64 now = bpf_ktime_get_boot_ns();
+	u64 *last = bpf_map_lookup_elem(&go_gc_last_start_map, &tgid);
+	if (last)
+		log2_hist_map_observe(&go_gc_interval_hist_map, &tgid, now - *last);
+
+	bpf_map_update_elem(&go_gc_last_start_map, &tgid, &now, BPF_ANY);
+	return 0;
+}
+
+// 同一个进程同一时间只有一次 STW, 以 tgid 为 key 记录开始时间
+static int trace_runtime_stoptheworld_enter(struct pt_regs *ctx)
+{
+	int tgid = bpf_get_current_pid_tgid() >> 32;
+
+	struct pproc_cfg *cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+	if (!cfg || !cfg->enabled)
+		return 0;
+
+	u64 now = bpf_ktime_get_boot_ns();
+	bpf_map_update_elem(&go_stw_start_map, &tgid, &now, BPF_ANY);
+	return 0;
+}
+
+static int trace_runtime_starttheworld_enter(struct pt_regs *ctx)
+{
+	int tgid = bpf_get_current_pid_tgid() >> 32;
+
+	u64 *start = bpf_map_lookup_elem(&go_stw_start_map, &tgid);
+	if (!start)
+		return 0;
+
+	log2_hist_map_observe(&go_stw_hist_map, &tgid, bpf_ktime_get_boot_ns() - *start);
+	bpf_map_delete_elem(&go_stw_start_map, &tgid);
+	return 0;
+}
+
+// func runqput(pp *p, gp *g, next bool)
+// 新建、被唤醒和被抢占的协程都通过 runqput 进入 P 的本地队列,直接放入全局队列的不统计
+static int trace_runtime_runqput_enter(struct pt_regs *ctx)
+{
+	int tgid = bpf_get_current_pid_tgid() >> 32;
+
+	struct pproc_cfg *cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+	if (!cfg || !cfg->enabled || !cfg->go_sched_enabled)
+		return 0;
+
+	struct trace_object_key key = { .tgid = tgid, .coid = get_goid_from_g((void *)ctx->bx) };
+	u64 now = bpf_ktime_get_boot_ns();
+	bpf_map_update_elem(&go_runnable_map, &key, &now, BPF_ANY);
+	return 0;
+}
+
+// func execute(gp *g, inheritTime bool)
+static int trace_runtime_execute_enter(struct pt_regs *ctx)
+{
+	int tgid = bpf_get_current_pid_tgid() >> 32;
+
+	struct trace_object_key key = { .tgid = tgid, .coid = get_goid_from_g((void *)ctx->ax) };
+	u64 *enqueue = bpf_map_lookup_elem(&go_runnable_map, &key);
+	if (!enqueue)
+		return 0;
+
+	log2_hist_map_observe(&go_sched_latency_hist_map, &tgid, bpf_ktime_get_boot_ns() - *enqueue);
+	bpf_map_delete_elem(&go_runnable_map, &key);
+	return 0;
+}
+
+// runtime.goexit 是汇编实现的,由它调用的 goexit1 依然在协程的栈上执行
+static int trace_runtime_goexit1_enter(struct pt_regs *ctx)
+{
+	int tgid = bpf_get_current_pid_tgid() >> 32;
+
+	struct pproc_cfg *cfg = bpf_map_lookup_elem(&pproc_cfg_map, &tgid);
+	if (!cfg || !cfg->enabled || !cfg->go_sched_enabled)
+		return 0;
+
+	add_go_goroutines(tgid, -1);
+	return 0;
+}
+
 #endif
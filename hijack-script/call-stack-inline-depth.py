@@ -0,0 +1,34 @@
+#!/usr/bin/python3
+# SPDX-License-Identifier: Apache-2.0
+import os
+import socket
+import struct
+import sys
+import uuid
+
+# 调用栈直接写入事件的深度, 0 表示使用 stack_trace_map, 小于 0 表示不修改
+call_stack_depth = int(sys.argv[1])  # 手动添加的 uprobe
+handle_mm_fault_depth = int(sys.argv[2])  # 缺页异常
+offcpu_depth = int(sys.argv[3])  # 线程切出
+
+# 创建连接
+client_file = '/tmp/hijack-{}.sock'.format(uuid.uuid4())
+server_file = "/var/run/hijack-ctl.sock"
+unix_domain_socket = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+unix_domain_socket.bind(client_file)
+unix_domain_socket.connect(server_file)
+
+# 组装字节流并发送
+bytes_to_send = struct.pack("=Iiiii", 17, call_stack_depth, handle_mm_fault_depth, offcpu_depth, 0)
+unix_domain_socket.send(bytes_to_send)
+
+# 接收字节流并解析
+bytes_to_unpack = unix_domain_socket.recv(len(bytes_to_send))
+_, call_stack_depth, handle_mm_fault_depth, offcpu_depth, ret = struct.unpack("=Iiiii", bytes_to_unpack)
+
+# 打印结果
+print(call_stack_depth, handle_mm_fault_depth, offcpu_depth, ret)
+
+# 断开连接,清理资源
+unix_domain_socket.close()
+os.unlink(client_file)
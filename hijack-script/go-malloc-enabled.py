@@ -0,0 +1,34 @@
+#!/usr/bin/python3
+# SPDX-License-Identifier: Apache-2.0
+import os
+import socket
+import struct
+import sys
+import uuid
+
+# 开始统计指定 Go 进程的堆内存分配, 需要同时开启进程监控
+event_tgid = int(sys.argv[1])  # 本功能影响的进程
+event_enabled = int(sys.argv[2])  # 是否启用
+event_sample_bytes = int(sys.argv[3]) if len(sys.argv) > 3 else 0  # 平均每分配多少字节采样一次, 0 表示使用默认值
+
+# 创建连接
+client_file = '/tmp/hijack-{}.sock'.format(uuid.uuid4())
+server_file = "/var/run/hijack-ctl.sock"
+unix_domain_socket = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+unix_domain_socket.bind(client_file)
+unix_domain_socket.connect(server_file)
+
+# 组装字节流并发送
+bytes_to_send = struct.pack("=IiiIi", 31, event_tgid, event_enabled, event_sample_bytes, 0)
+unix_domain_socket.send(bytes_to_send)
+
+# 接收字节流并解析
+bytes_to_unpack = unix_domain_socket.recv(len(bytes_to_send))
+_, _, _, _, ret = struct.unpack("=IiiIi", bytes_to_unpack)
+
+# 打印结果
+print(ret)
+
+# 断开连接,清理资源
+unix_domain_socket.close()
+os.unlink(client_file)
@@ -0,0 +1,34 @@
+#!/usr/bin/python3
+# SPDX-License-Identifier: Apache-2.0
+import os
+import socket
+import struct
+import sys
+import uuid
+
+# 开始统计指定进程的 futex 锁等待时间和 pthread 锁持有时间, 需要同时开启进程监控
+# 只统计 FUTEX_WAIT/WAIT_BITSET/LOCK_PI/WAIT_REQUEUE_PI 等阻塞操作, 返回 EAGAIN 和超时返回 ETIMEDOUT 的等待不计入
+event_tgid = int(sys.argv[1])  # 本功能影响的进程
+event_enabled = int(sys.argv[2])  # 是否启用
+
+# 创建连接
+client_file = '/tmp/hijack-{}.sock'.format(uuid.uuid4())
+server_file = "/var/run/hijack-ctl.sock"
+unix_domain_socket = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+unix_domain_socket.bind(client_file)
+unix_domain_socket.connect(server_file)
+
+# 组装字节流并发送
+bytes_to_send = struct.pack("=Iiii", 25, event_tgid, event_enabled, 0)
+unix_domain_socket.send(bytes_to_send)
+
+# 接收字节流并解析
+bytes_to_unpack = unix_domain_socket.recv(len(bytes_to_send))
+_, _, _, ret = struct.unpack("=Iiii", bytes_to_unpack)
+
+# 打印结果
+print(ret)
+
+# 断开连接,清理资源
+unix_domain_socket.close()
+os.unlink(client_file)
@@ -0,0 +1,92 @@
+#!/usr/bin/python3
+# SPDX-License-Identifier: Apache-2.0
+import os
+import socket
+import struct
+import sys
+import time
+import uuid
+
+# 查询 hijack 自身的运行指标,间隔两次查询计算速率
+interval = float(sys.argv[1]) if len(sys.argv) > 1 else 1.0  # 两次查询的间隔秒数
+
+# 与 hijack-common 中的定义保持一致
+EVENT_TYPE_MAX = 16  # CONFIG_METRICS_EVENT_TYPE_MAX
+HIST_SLOTS = 32  # CONFIG_METRICS_HIST_SLOTS
+EVENT_NAMES = ["unspec", "log", "user_call_stack", "sched", "tcp_probe", "offcpu_call_stack", "user_call_stack_inline", "offcpu_call_stack_inline"]
+
+FORMAT = "=IQ{}Q{}Q{}Q{}Q{}Q{}Q3Q6Qi".format(EVENT_TYPE_MAX, EVENT_TYPE_MAX, EVENT_TYPE_MAX * HIST_SLOTS, HIST_SLOTS, HIST_SLOTS, HIST_SLOTS)
+
+# 创建连接
+client_file = '/tmp/hijack-{}.sock'.format(uuid.uuid4())
+server_file = "/var/run/hijack-ctl.sock"
+unix_domain_socket = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+unix_domain_socket.bind(client_file)
+unix_domain_socket.connect(server_file)
+
+
+def query():
+    # 组装字节流并发送
+    bytes_to_send = struct.pack("=I", 14) + bytes(struct.calcsize(FORMAT) - 4)
+    unix_domain_socket.send(bytes_to_send)
+
+    # 接收字节流并解析
+    values = list(struct.unpack(FORMAT, unix_domain_socket.recv(len(bytes_to_send))))
+    metrics = {"nsec": values[1]}
+    pos = 2
+    metrics["event_count"] = values[pos:pos + EVENT_TYPE_MAX]
+    pos += EVENT_TYPE_MAX
+    metrics["event_handle_ns"] = values[pos:pos + EVENT_TYPE_MAX]
+    pos += EVENT_TYPE_MAX
+    metrics["event_handle_hist"] = [values[pos + i * HIST_SLOTS:pos + (i + 1) * HIST_SLOTS] for i in range(EVENT_TYPE_MAX)]
+    pos += EVENT_TYPE_MAX * HIST_SLOTS
+    for name in ["event_delay_hist", "symbolize_hist", "control_hist"]:
+        metrics[name] = values[pos:pos + HIST_SLOTS]
+        pos += HIST_SLOTS
+    metrics["ringbuf_size"], metrics["ringbuf_avail"], metrics["ringbuf_avail_max"] = values[pos:pos + 3]
+    pos += 3
+    for name in ["stack_drained", "stack_collisions", "stack_evictions", "stack_store_size", "stackid_collisions", "stackid_errors"]:
+        metrics[name] = values[pos]
+        pos += 1
+    return metrics
+
+
+def percentile(hist, p):
+    # 返回对应槽位的上界,单位纳秒
+    total = sum(hist)
+    if total == 0:
+        return 0
+    count = 0
+    for slot, value in enumerate(hist):
+        count += value
+        if count >= total * p:
+            return 1 << (slot + 1)
+    return 1 << len(hist)
+
+
+def show_hist(name, hist):
+    print("{:<24} count={:<12} p50<{}ns p99<{}ns".format(name, sum(hist), percentile(hist, 0.5), percentile(hist, 0.99)))
+
+
+before = query()
+time.sleep(interval)
+after = query()
+seconds = (after["nsec"] - before["nsec"]) / 1e9
+
+# 打印结果
+for idx, name in enumerate(EVENT_NAMES):
+    count = after["event_count"][idx] - before["event_count"][idx]
+    handle_ns = after["event_handle_ns"][idx] - before["event_handle_ns"][idx]
+    avg = handle_ns // count if count else 0
+    print("{:<24} events/s={:<12.1f} avg={}ns p99<{}ns".format(name, count / seconds, avg, percentile(after["event_handle_hist"][idx], 0.99)))
+show_hist("delay", after["event_delay_hist"])
+show_hist("symbolize", after["symbolize_hist"])
+show_hist("control", after["control_hist"])
+print("{:<24} avail={} max={} size={}".format("ringbuf", after["ringbuf_avail"], after["ringbuf_avail_max"], after["ringbuf_size"]))
+print("{:<24} drained/s={:<10.1f} store={} collisions={} evictions={}".format("stack", (after["stack_drained"] - before["stack_drained"]) / seconds,
+                                                                           after["stack_store_size"], after["stack_collisions"], after["stack_evictions"]))
+print("{:<24} collisions={} errors={}".format("stackid", after["stackid_collisions"], after["stackid_errors"]))
+
+# 断开连接,清理资源
+unix_domain_socket.close()
+os.unlink(client_file)
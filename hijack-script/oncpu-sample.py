@@ -0,0 +1,39 @@
+#!/usr/bin/python3
+# SPDX-License-Identifier: Apache-2.0
+import os
+import socket
+import struct
+import sys
+import uuid
+
+# 按进程或者 cgroup 开关 oncpu 采样,结果定期以 folded 格式写入 /var/log/hijack-oncpu.folded
+tgid = int(sys.argv[1])  # 进程号, 0 表示不修改
+cgroup = sys.argv[2].encode()  # cgroup v2 中的路径, 空字符串表示不修改
+event_enabled = int(sys.argv[3])  # 是否启用
+frequency = int(sys.argv[4]) if len(sys.argv) > 4 else 0  # 采样频率, 0 表示保持, 小于 0 表示停止采样
+
+# 与 hijack-common 中的定义保持一致
+CGROUP_PATH_LEN_MAX = 256  # CONFIG_CGROUP_PATH_LEN_MAX
+FORMAT = "=Ii{}siii".format(CGROUP_PATH_LEN_MAX)
+
+# 创建连接
+client_file = '/tmp/hijack-{}.sock'.format(uuid.uuid4())
+server_file = "/var/run/hijack-ctl.sock"
+unix_domain_socket = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+unix_domain_socket.bind(client_file)
+unix_domain_socket.connect(server_file)
+
+# 组装字节流并发送
+bytes_to_send = struct.pack(FORMAT, 19, tgid, cgroup, event_enabled, frequency, 0)
+unix_domain_socket.send(bytes_to_send)
+
+# 接收字节流并解析
+bytes_to_unpack = unix_domain_socket.recv(len(bytes_to_send))
+_, _, _, _, _, ret = struct.unpack(FORMAT, bytes_to_unpack)
+
+# 打印结果
+print(ret)
+
+# 断开连接,清理资源
+unix_domain_socket.close()
+os.unlink(client_file)
@@ -0,0 +1,44 @@
+#!/usr/bin/python3
+# SPDX-License-Identifier: Apache-2.0
+import os
+import socket
+import struct
+import uuid
+
+# 查询每个 eBPF 程序的运行统计
+
+# 与 hijack-common 中的定义保持一致
+PROG_STATS_MAX = 96  # CONFIG_PROG_STATS_MAX
+PROG_NAME_LEN_MAX = 48  # CONFIG_PROG_NAME_LEN_MAX
+
+STAT_FORMAT = "{}sQQQQ".format(PROG_NAME_LEN_MAX)
+FORMAT = "=Ii" + STAT_FORMAT * PROG_STATS_MAX + "i"
+
+# 创建连接
+client_file = '/tmp/hijack-{}.sock'.format(uuid.uuid4())
+server_file = "/var/run/hijack-ctl.sock"
+unix_domain_socket = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+unix_domain_socket.bind(client_file)
+unix_domain_socket.connect(server_file)
+
+# 组装字节流并发送
+bytes_to_send = struct.pack("=I", 15) + bytes(struct.calcsize(FORMAT) - 4)
+unix_domain_socket.send(bytes_to_send)
+
+# 接收字节流并解析
+values = struct.unpack(FORMAT, unix_domain_socket.recv(len(bytes_to_send)))
+nr = values[1]
+stats = []
+for idx in range(nr):
+    name, run_cnt, run_time_ns, ns_per_run, cpu_share_ppm = values[2 + idx * 5:2 + (idx + 1) * 5]
+    stats.append((name.rstrip(b'\0').decode(), run_cnt, run_time_ns, ns_per_run, cpu_share_ppm))
+
+# 打印结果,按 CPU 占比排序
+print("{:<48} {:>16} {:>20} {:>12} {:>12}".format("name", "run_cnt", "run_time_ns", "ns/run", "cpu(ppm)"))
+for stat in sorted(stats, key=lambda stat: stat[4], reverse=True):
+    print("{:<48} {:>16} {:>20} {:>12} {:>12}".format(*stat))
+print(values[-1])
+
+# 断开连接,清理资源
+unix_domain_socket.close()
+os.unlink(client_file)
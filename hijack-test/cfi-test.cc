@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/binary.h"
+#include "hijack/cfi.h"
+#include <cassert>
+#include <execinfo.h>
+#include <string>
+#include <unistd.h>
+
+static const int DEPTH = 64;
+
+// 与内核上报的快照一样,只保存寄存器和从 sp 开始的一段栈
+static struct cfi_regs regs;
+static uint8_t stack[4096];
+
+__attribute__((noinline)) static int snapshot(void **frames)
+{
+	asm volatile("lea (%%rip), %0\n\tmov %%rsp, %1\n\tmov %%rbp, %2" : "=r"(regs.ip), "=r"(regs.sp), "=r"(regs.bp));
+	memcpy(stack, (void *)regs.sp, sizeof(stack));
+
+	// 避免尾调用,否则 backtrace 中没有当前函数
+	volatile int nframe = backtrace(frames, DEPTH);
+	return nframe;
+}
+
+// 编译时不保留帧指针,只能通过 .eh_frame 展开
+__attribute__((noinline)) static int leaf(void **frames, int x)
+{
+	volatile int buffer[16];
+	buffer[x % 16] = snapshot(frames);
+	return buffer[x % 16];
+}
+
+__attribute__((noinline)) static int middle(void **frames, int x)
+{
+	std::string s(x, 'a');
+	volatile int nframe = leaf(frames, s.size());
+	return nframe;
+}
+
+int main()
+{
+	struct binary *ctx = binary_init(getpid());
+	assert(ctx);
+
+	class cfi_table *table = binary_cfi(ctx);
+	assert(table && table->size() > 0);
+	assert(binary_cfi(ctx) == table);
+	assert(table->lookup((uintptr_t)middle - binary_load_bias(ctx)));
+
+	void *frames[DEPTH];
+	int nframe = middle(frames, 32);
+
+	uintptr_t ip[DEPTH] = {};
+	int nr = cfi_unwind(table, binary_load_bias(ctx), regs, stack, sizeof(stack), ip, DEPTH);
+
+	// 第一帧分别在 snapshot 和 backtrace 中,之后的返回地址应该完全一致, 至少包括 leaf、middle 和 main
+	assert(nr >= 4 && nframe >= 4);
+	for (int idx = 1; idx < 4; ++idx) {
+		assert(ip[idx] == (uintptr_t)frames[idx]);
+	}
+
+	binary_free(ctx);
+	return 0;
+}
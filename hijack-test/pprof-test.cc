@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/pprof.h"
+#include <cassert>
+#include <zlib.h>
+
+static std::string gzip_decompress(const std::string &in)
+{
+	z_stream stream = {};
+	assert(inflateInit2(&stream, MAX_WBITS + 16) == Z_OK);
+
+	std::string out(in.size() * 16 + 1024, '\0');
+	stream.next_in = (Bytef *)in.data();
+	stream.avail_in = in.size();
+	stream.next_out = (Bytef *)out.data();
+	stream.avail_out = out.size();
+	assert(inflate(&stream, Z_FINISH) == Z_STREAM_END);
+	out.resize(stream.total_out);
+	inflateEnd(&stream);
+	return out;
+}
+
+int main()
+{
+	class pprof_profile profile({{"offcpu", "nanoseconds"}, {"offcpu", "count"}}, 1, 2);
+	uint64_t mapping = profile.add_mapping(0x1000, 0x2000, 0, "/bin/test");
+	assert(mapping == 1);
+
+	// 相同的地址只创建一次,相同的函数只创建一次
+	uint64_t a = profile.add_location(mapping, 0x1100, "main", "test.cc", 10);
+	uint64_t b = profile.add_location(mapping, 0x1100, "main", "test.cc", 10);
+	uint64_t c = profile.add_location(mapping, 0x1200, "main", "test.cc", 11);
+	assert(a == b && a != c);
+	assert(profile.find_location(mapping, 0x1200) == c);
+	assert(profile.find_location(mapping, 0x1300) == 0);
+
+	profile.add_sample({c, a}, {100, 1});
+	profile.add_sample({c, a}, {200, 1});
+
+	std::string encoded = profile.encode();
+	// 第一个字段是 sample_type, tag 为 (1 << 3) | 2
+	assert(!encoded.empty() && encoded[0] == 0x0a);
+
+	// 相同调用栈的样本合并为一个,数值累加: value 字段 packed 编码为 [300, 2]
+	const std::string values = std::string("\x12\x03\xac\x02\x02", 5);
+	assert(encoded.find(values) != std::string::npos);
+
+	std::string compressed;
+	assert(gzip_compress(encoded, compressed) == 0);
+	assert(gzip_decompress(compressed) == encoded);
+
+	return 0;
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/python.h"
+#include <cassert>
+
+int main()
+{
+	// CPython 3.11 编译下面的函数得到的 co_linetable, co_firstlineno 为 1
+	//
+	// def f(x):
+	//     y = x + 1
+	//     if y > 2:
+	//         return [i for i in range(y)]
+	//
+	//     z = (x +
+	//          2)
+	//     return z
+	const unsigned char bytes[] = { 0x80, 0x00, 0xd8, 0x08, 0x09, 0x88, 0x41, 0x89, 0x05, 0x80, 0x41, 0xd8, 0x07, 0x08, 0x88, 0x31, 0x82, 0x75,
+					0x80, 0x75, 0xd8, 0x0f, 0x24, 0xd0, 0x0f, 0x24, 0x9d, 0x35, 0xa0, 0x11, 0x99, 0x38, 0x9c, 0x38, 0xd0, 0x0f, 0x24,
+					0xd1, 0x0f, 0x24, 0xd4, 0x0f, 0x24, 0xd0, 0x08, 0x24, 0xe0, 0x09, 0x0a, 0xd8, 0x09, 0x0a, 0xf1, 0x03, 0x01, 0x0a,
+					0x0b, 0x80, 0x41, 0xe0, 0x0b, 0x0c, 0x80, 0x48 };
+	const std::string linetable((const char *)bytes, sizeof(bytes));
+
+	// 下标以 2 字节的指令为单位,与 co_lines() 中的字节偏移相差一倍
+	assert(python_linetable_lookup(linetable, 1, 0) == 1);
+	assert(python_linetable_lookup(linetable, 1, 1) == 2);
+	assert(python_linetable_lookup(linetable, 1, 6) == 3);
+	assert(python_linetable_lookup(linetable, 1, 12) == 4);
+	assert(python_linetable_lookup(linetable, 1, 37) == 6);
+	assert(python_linetable_lookup(linetable, 1, 38) == 7);
+	assert(python_linetable_lookup(linetable, 1, 39) == 6);
+	assert(python_linetable_lookup(linetable, 1, 43) == 8);
+
+	// 超出字节码范围时没有行号
+	assert(python_linetable_lookup(linetable, 1, 44) == -1);
+	assert(python_linetable_lookup("", 1, 0) == -1);
+	return 0;
+}
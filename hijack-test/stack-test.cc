@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/metrics.h"
+#include "hijack/process.h"
+#include "hijack/stack.h"
+
+class metrics metrics;
+
+static volatile int counter;
+
+// 函数体不同,避免被编译器合并成同一个地址
+__attribute__((noinline)) static void first()
+{
+	counter = counter + 1;
+}
+
+__attribute__((noinline)) static void second()
+{
+	counter = counter + 2;
+}
+
+int main()
+{
+	struct binary *ctx;
+	class process_collector collector;
+	class stack_store store;
+	collector.scan_procfs();
+
+	ctx = collector.fetch_binnary_ctx(getpid());
+	assert(ctx);
+
+	uintptr_t ip[CONFIG_MAX_STACK_DEPTH] = {(uintptr_t)first, (uintptr_t)second};
+	bool created;
+
+	// 同一类事件同一个进程的相同调用栈只符号化一次
+	struct stack_sample *a = store.record(RB_EVENT_USER_CALL_STACK, getpid(), ctx, ip, &created);
+	assert(created);
+	struct stack_sample *b = store.record(RB_EVENT_USER_CALL_STACK, getpid(), ctx, ip, &created);
+	assert(!created && a == b);
+
+	// 不同类型的事件各自计数,但共享符号化后的调用栈
+	struct stack_sample *c = store.record(RB_EVENT_OFFCPU_CALL_STACK, getpid(), ctx, ip, &created);
+	assert(created && c != a && c->hash == a->hash);
+
+	const struct stack &stack = store.lookup_stack(a->hash);
+	assert(stack.frames.size() == 2);
+	assert(stack.refcnt == 2);
+	assert(store.lookup_frame(stack.frames[0]) != store.lookup_frame(stack.frames[1]));
+
+	// 原始地址不同的调用栈不会命中已有的样本
+	uintptr_t other[CONFIG_MAX_STACK_DEPTH] = {(uintptr_t)second, (uintptr_t)first};
+	struct stack_sample *d = store.record(RB_EVENT_USER_CALL_STACK, getpid(), ctx, other, &created);
+	assert(created && d != a && d->hash != a->hash);
+
+	return 0;
+}
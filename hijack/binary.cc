@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "hijack/binary.h"
+#include "hijack/cfi.h"
 #include <string>
 #include <unistd.h>
 
@@ -121,6 +122,7 @@ void binary_free(struct binary *ctx)
 	if (!ctx)
 		return;
 
+	delete ctx->cfi;
 	free(ctx->syms);
 	bfd_close(ctx->abfd);
 	free(ctx);
@@ -179,3 +181,31 @@ long binary_sym_to_addr(struct binary *ctx, const char *symbol)
 
 	return 0;
 }
+
+bfd_vma binary_load_bias(struct binary *ctx)
+{
+	return binary_no_pie(ctx) ? 0 : ctx->addr_start;
+}
+
+class cfi_table *binary_cfi(struct binary *ctx)
+{
+	if (!ctx)
+		return NULL;
+	if (ctx->cfi)
+		return ctx->cfi;
+
+	ctx->cfi = new cfi_table();
+	asection *section = bfd_get_section_by_name(ctx->abfd, ".eh_frame");
+	if (!section)
+		return ctx->cfi;
+
+	bfd_size_type size = bfd_section_size(section);
+	bfd_byte *data = NULL;
+	if (!bfd_malloc_and_get_section(ctx->abfd, section, &data))
+		return ctx->cfi;
+
+	if (ctx->cfi->parse(data, size, bfd_section_vma(section)))
+		printf("parse .eh_frame failed: %s\n", ctx->abfd->filename);
+	free(data);
+	return ctx->cfi;
+}
@@ -11,12 +11,17 @@
 #define PACKAGE_VERSION "0.0.0"
 #include <bfd.h>
 
+class cfi_table;
+
 struct binary {
 	bfd *abfd;
 	bfd_vma addr_start;
 	asymbol **syms;
 	long nsym;
 
+	// 第一次展开调用栈时解析 .eh_frame
+	class cfi_table *cfi;
+
 	// 以下为内部使用的临时变量
 	asection *section;
 	bfd_vma pc;
@@ -34,4 +39,9 @@ void binary_free(struct binary *ctx);
 bool binary_addr_to_line(struct binary *ctx, bfd_vma pc, binary_addr2line_callback_t callback, void *data);
 long binary_sym_to_addr(struct binary *ctx, const char *symbol);
 
+// 运行地址与文件中虚拟地址的差
+bfd_vma binary_load_bias(struct binary *ctx);
+// 没有 .eh_frame 时返回空表,只解析一次
+class cfi_table *binary_cfi(struct binary *ctx);
+
 #endif
@@ -2,7 +2,13 @@
 #include "hijack/callback.h"
 #include "hijack-common/types.h"
 #include "hijack/binary.h"
+#include "hijack/cfi.h"
+#include "hijack/metrics.h"
+#include "hijack/stack.h"
+#include "hijack/stack_drainer.h"
 #include "hijack/process.h"
+#include "hijack/profile.h"
+#include "hijack/python.h"
 #include "hijack/hijack.skel.h"
 #include <bpf/bpf.h>
 #include <csignal>
@@ -10,12 +16,17 @@
 #include <cstring>
 #include <ctime>
 #include <iostream>
-#include <map>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/un.h>
 
 extern struct hijack *skel;
 extern class process_collector process_collector;
+extern class metrics metrics;
+extern class stack_drainer stack_drainer;
+extern class stack_store stack_store;
+extern class profile_collector profile_collector;
+extern class python_unwinder python_unwinder;
 
 static const long NS_PER_SEC = 1000000000L;
 
@@ -64,121 +75,273 @@ static int handle_log_event(void *ctx, void *data, size_t len)
 	return 0;
 }
 
-static void stack_trace_callback(bfd_vma pc, const char *functionname, const char *filename, int line, void *data)
+// 打印样本对应的调用栈,原始地址只对当前进程有意义,栈帧内容在各进程间共享
+static void print_call_stack(const struct stack_sample *sample, const uintptr_t *ip)
 {
-	int idx = *(int *)data;
-	printf("#%d %p at %s in %s:%d\n", idx, (void *)pc, functionname, filename, line);
+	const struct stack &stack = stack_store.lookup_stack(sample->hash);
+	for (size_t idx = 0; idx < stack.frames.size(); ++idx) {
+		printf("#%zu %p at %s\n", idx, (void *)ip[idx], stack_store.lookup_frame(stack.frames[idx]).data());
+	}
+	printf("\n");
 }
 
-static int handle_user_call_stack_event(void *ctx, void *data, size_t len)
+// 紧凑结构体中的地址可能不对齐,复制到以 0 结尾的数组中
+static int copy_inline_call_stack(uintptr_t *ip, const void *src, int nr, size_t len, size_t offset)
 {
-	struct stack_value {
-		uintptr_t ip[CONFIG_MAX_STACK_DEPTH];
-		uint32_t tgid;
-		uint64_t cnt;
-	} tmp = {};
+	if (nr <= 0 || nr > CONFIG_MAX_STACK_DEPTH || len < offset + nr * sizeof(unsigned long long))
+		return -1;
 
-	static std::map<uint64_t, class stack_value> stack_map;
+	memset(ip, 0, CONFIG_MAX_STACK_DEPTH * sizeof(ip[0]));
+	memcpy(ip, src, nr * sizeof(ip[0]));
+	return 0;
+}
 
-	struct event_user_call_stack *e = (struct event_user_call_stack *)data;
-	uint64_t stackid = e->stackid;
+// 事件来源对应的 pprof 数值列
+static int user_call_stack_pprof_type(int source)
+{
+	return source == USER_CALL_STACK_SOURCE_PAGE_FAULT ? PPROF_VALUE_PAGE_FAULT_COUNT : PPROF_VALUE_CALL_STACK_COUNT;
+}
 
-	int ret = bpf_map_lookup_elem(bpf_map__fd(skel->maps.stack_trace_map), &stackid, &tmp.ip);
-	if (ret) {
-		printf("stack_trace_map lookup failed, stackid=%d\n", stackid);
+static int report_user_call_stack(unsigned long long nsec, int tgid, const char *comm, const char *name, int pprof_type, const uintptr_t *ip)
+{
+	struct binary *binary_ctx = process_collector.fetch_binnary_ctx(tgid);
+	if (!binary_ctx) {
+		printf("fetch_binnary_ctx failed\n");
 		return 0;
 	}
 
+	bool created;
+	struct stack_sample *sample = stack_store.record(RB_EVENT_USER_CALL_STACK, tgid, binary_ctx, ip, &created);
+	sample->cnt += 1;
+	profile_collector.record_pprof(tgid, ip, NULL, pprof_type, 1);
+
 	struct timespec now;
-	clock_get_event_time(e->nsec, &now);
+	clock_get_event_time(nsec, &now);
 
 	struct tm t;
 	char date_time[32];
 	strftime(date_time, sizeof(date_time), "%Y-%m-%d %H:%M:%S", localtime_r(&now.tv_sec, &t));
+	printf("[%s.%09lu] %s: stack=%016lx tgid=%d comm=%s cnt=%lu\n", date_time, now.tv_nsec, name, sample->hash, tgid, comm, sample->cnt);
 
-	auto it = stack_map.find(stackid);
-	if (it != stack_map.end() && it->second.tgid == e->tgid && memcmp(it->second.ip, tmp.ip, sizeof(tmp.ip)) == 0) {
-		printf("[%s.%09lu] %s: stackid=%d tgid=%d comm=%s cnt=%llu\n", date_time, now.tv_nsec, e->name, stackid, e->tgid, e->comm, ++it->second.cnt);
+	if (created)
+		print_call_stack(sample, ip);
+	return 0;
+}
+
+static int report_offcpu_call_stack(unsigned long long nsec, int tgid, int pid, const char *comm, unsigned long long duration, const uintptr_t *ip)
+{
+	struct binary *binary_ctx = process_collector.fetch_binnary_ctx(tgid);
+	if (!binary_ctx) {
+		printf("fetch_binnary_ctx failed\n");
+		return 0;
+	}
+
+	bool created;
+	struct stack_sample *sample = stack_store.record(RB_EVENT_OFFCPU_CALL_STACK, tgid, binary_ctx, ip, &created);
+	sample->cnt += 1;
+	sample->duration += duration;
+	profile_collector.record_pprof(tgid, ip, NULL, PPROF_VALUE_OFFCPU_NS, duration);
+	profile_collector.record_pprof(tgid, ip, NULL, PPROF_VALUE_OFFCPU_COUNT, 1);
+
+	struct timespec now;
+	clock_get_event_time(nsec, &now);
+
+	struct tm t;
+	char date_time[32];
+	strftime(date_time, sizeof(date_time), "%Y-%m-%d %H:%M:%S", localtime_r(&now.tv_sec, &t));
+	printf("[%s.%09lu] offcpu: tgid=%d pid=%d stack=%016lx comm=%s duration=%llu(%lu) cnt=%lu\n", date_time, now.tv_nsec, tgid, pid, sample->hash, comm, duration,
+	       sample->duration, sample->cnt);
+
+	if (created)
+		print_call_stack(sample, ip);
+	return 0;
+}
+
+// 唤醒者的调用栈按唤醒者所在的进程符号化,首次出现时打印
+static int report_waker(int waker_tgid, int waker_pid, long waker_stackid)
+{
+	// 没有记录到唤醒者,例如超时或者信号唤醒
+	if (!waker_pid)
+		return 0;
+
+	uintptr_t ip[CONFIG_MAX_STACK_DEPTH] = {};
+	if (waker_stackid < 0 || stack_drainer.lookup(waker_stackid, ip)) {
+		printf("waker: tgid=%d pid=%d stack=unknown\n", waker_tgid, waker_pid);
+		return 0;
+	}
+
+	struct binary *binary_ctx = process_collector.fetch_binnary_ctx(waker_tgid);
+	if (!binary_ctx) {
+		printf("waker: tgid=%d pid=%d fetch_binnary_ctx failed\n", waker_tgid, waker_pid);
+		return 0;
+	}
+
+	bool created;
+	struct stack_sample *sample = stack_store.record(STACK_KIND_WAKER, waker_tgid, binary_ctx, ip, &created);
+	sample->cnt += 1;
+	printf("waker: tgid=%d pid=%d stack=%016lx cnt=%lu\n", waker_tgid, waker_pid, sample->hash, sample->cnt);
+
+	if (created)
+		print_call_stack(sample, ip);
+	return 0;
+}
+
+static int handle_user_call_stack_event(void *ctx, void *data, size_t len)
+{
+	struct event_user_call_stack *e = (struct event_user_call_stack *)data;
+	uint64_t stackid = e->stackid;
+	uintptr_t ip[CONFIG_MAX_STACK_DEPTH] = {};
+
+	int ret = stack_drainer.lookup(stackid, ip);
+	if (ret) {
+		printf("stack_trace_map lookup failed, stackid=%d\n", stackid);
 		return 0;
-	} else {
-		tmp.tgid = e->tgid;
-		tmp.cnt = 1;
-		stack_map[stackid] = tmp;
-		printf("[%s.%09lu] %s: stackid=%d tgid=%d comm=%s cnt=1\n", date_time, now.tv_nsec, e->name, stackid, e->tgid, e->comm);
 	}
 
+	return report_user_call_stack(e->nsec, e->tgid, e->comm, e->name, user_call_stack_pprof_type(e->source), ip);
+}
+
+static int handle_user_call_stack_inline_event(void *ctx, void *data, size_t len)
+{
+	struct event_user_call_stack_inline *e = (struct event_user_call_stack_inline *)data;
+	uintptr_t ip[CONFIG_MAX_STACK_DEPTH];
+
+	if (copy_inline_call_stack(ip, e->ip, e->nr, len, offsetof(struct event_user_call_stack_inline, ip)))
+		return 0;
+
+	return report_user_call_stack(e->nsec, e->tgid, e->comm, e->name, user_call_stack_pprof_type(e->source), ip);
+}
+
+static int handle_user_stack_snapshot_event(void *ctx, void *data, size_t len)
+{
+	struct event_user_stack_snapshot *e = (struct event_user_stack_snapshot *)data;
+	if (e->size <= 0 || e->size > CONFIG_USER_STACK_SNAPSHOT_SIZE || len < offsetof(struct event_user_stack_snapshot, data) + e->size)
+		return 0;
+
 	struct binary *binary_ctx = process_collector.fetch_binnary_ctx(e->tgid);
 	if (!binary_ctx) {
 		printf("fetch_binnary_ctx failed\n");
 		return 0;
 	}
 
-	for (int idx = 0; idx < CONFIG_MAX_STACK_DEPTH; ++idx) {
-		if (!tmp.ip[idx])
-			break;
-		binary_addr_to_line(binary_ctx, tmp.ip[idx], stack_trace_callback, &idx);
+	struct cfi_regs regs = { .ip = e->ip, .sp = e->sp, .bp = e->bp };
+	uintptr_t ip[CONFIG_MAX_STACK_DEPTH] = {};
+	cfi_unwind(binary_cfi(binary_ctx), binary_load_bias(binary_ctx), regs, e->data, e->size, ip, CONFIG_MAX_STACK_DEPTH);
+	return report_user_call_stack(e->nsec, e->tgid, e->comm, e->name, user_call_stack_pprof_type(e->source), ip);
+}
+
+// 紧跟着的原生调用栈事件会打印时间,这里只打印解释器中的调用栈
+static int handle_python_call_stack_event(void *ctx, void *data, size_t len)
+{
+	struct event_python_call_stack *e = (struct event_python_call_stack *)data;
+	if (e->nr <= 0 || e->nr > CONFIG_PYTHON_STACK_DEPTH || len < offsetof(struct event_python_call_stack, frames) + e->nr * sizeof(e->frames[0]))
+		return 0;
+
+	std::vector<std::string> frames = python_unwinder.symbolize(skel, e->tgid, e->frames, e->nr);
+	printf("%s: python tgid=%d comm=%s\n", e->name, e->tgid, e->comm);
+	for (size_t idx = 0; idx < frames.size(); ++idx) {
+		printf("#%zu %s\n", idx, frames[idx].data());
 	}
 	printf("\n");
-
 	return 0;
 }
 
 static int handle_offcpu_call_stack_event(void *ctx, void *data, size_t len)
 {
-	struct stack_value {
-		uintptr_t ip[CONFIG_MAX_STACK_DEPTH];
-		uint32_t tgid;
-		uint64_t cnt;
-		uint64_t duration;
-	} tmp = {};
-
-	static std::map<uint64_t, class stack_value> stack_map;
-
 	struct event_offcpu_call_stack *e = (struct event_offcpu_call_stack *)data;
 	uint64_t stackid = e->stackid;
+	uintptr_t ip[CONFIG_MAX_STACK_DEPTH] = {};
 
-	int ret = bpf_map_lookup_elem(bpf_map__fd(skel->maps.stack_trace_map), &stackid, &tmp.ip);
+	int ret = stack_drainer.lookup(stackid, ip);
 	if (ret) {
 		printf("stack_trace_map lookup failed, stackid=%d\n", stackid);
 		return 0;
 	}
 
+	report_offcpu_call_stack(e->nsec, e->tgid, e->pid, e->comm, e->duration, ip);
+	return report_waker(e->waker_tgid, e->waker_pid, e->waker_stackid);
+}
+
+static int handle_offcpu_call_stack_inline_event(void *ctx, void *data, size_t len)
+{
+	struct event_offcpu_call_stack_inline *e = (struct event_offcpu_call_stack_inline *)data;
+	uintptr_t ip[CONFIG_MAX_STACK_DEPTH];
+
+	if (copy_inline_call_stack(ip, e->ip, e->nr, len, offsetof(struct event_offcpu_call_stack_inline, ip)))
+		return 0;
+
+	report_offcpu_call_stack(e->nsec, e->tgid, e->pid, e->comm, e->duration, ip);
+	return report_waker(e->waker_tgid, e->waker_pid, e->waker_stackid);
+}
+
+static const char *io_outlier_file_type(unsigned int i_mode)
+{
+	switch (i_mode & S_IFMT) {
+	case S_IFSOCK:
+		return "socket";
+	case S_IFREG:
+		return "regular";
+	case S_IFIFO:
+		return "fifo";
+	case S_IFCHR:
+		return "char";
+	default:
+		return "other";
+	}
+}
+
+// 用户栈与其他事件一样按进程去重,首次出现时打印; 内核栈每次都打印,同一个用户栈可能落在不同的内核路径上
+static int handle_io_outlier_event(void *ctx, void *data, size_t len)
+{
+	struct event_io_outlier *e = (struct event_io_outlier *)data;
+
 	struct timespec now;
 	clock_get_event_time(e->nsec, &now);
 
 	struct tm t;
 	char date_time[32];
 	strftime(date_time, sizeof(date_time), "%Y-%m-%d %H:%M:%S", localtime_r(&now.tv_sec, &t));
+	printf("[%s.%09lu] io_outlier: %s tgid=%d pid=%d comm=%s fd=%d type=%s ret=%d latency=%llu", date_time, now.tv_nsec, e->name, e->tgid, e->pid, e->comm, e->fd,
+	       io_outlier_file_type(e->i_mode), e->ret, e->latency);
 
-	auto it = stack_map.find(stackid);
-	if (it != stack_map.end() && it->second.tgid == e->tgid && memcmp(it->second.ip, tmp.ip, sizeof(tmp.ip)) == 0) {
-		it->second.cnt += 1;
-		it->second.duration += e->duration;
-		printf("[%s.%09lu] offcpu: tgid=%d pid=%d stackid=%d comm=%s duration=%llu(%llu) cnt=%llu\n", date_time, now.tv_nsec, e->tgid, e->pid, stackid, e->comm,
-		       e->duration, it->second.duration, it->second.cnt);
-		return 0;
+	uintptr_t ip[CONFIG_MAX_STACK_DEPTH] = {};
+	struct binary *binary_ctx = process_collector.fetch_binnary_ctx(e->tgid);
+	if (e->user_stackid < 0 || stack_drainer.lookup(e->user_stackid, ip) || !binary_ctx) {
+		printf(" stack=unknown\n");
 	} else {
-		tmp.tgid = e->tgid;
-		tmp.cnt = 1;
-		tmp.duration += e->duration;
-		stack_map[stackid] = tmp;
-		printf("[%s.%09lu] offcpu: tgid=%d pid=%d stackid=%d comm=%s duration=%llu(%llu) cnt=1\n", date_time, now.tv_nsec, e->tgid, e->pid, stackid, e->comm, e->duration,
-		       tmp.duration);
+		bool created;
+		struct stack_sample *sample = stack_store.record(RB_EVENT_IO_OUTLIER, e->tgid, binary_ctx, ip, &created);
+		sample->cnt += 1;
+		sample->duration += e->latency;
+		printf(" stack=%016lx duration=%lu cnt=%lu\n", sample->hash, sample->duration, sample->cnt);
+		if (created)
+			print_call_stack(sample, ip);
 	}
 
-	struct binary *binary_ctx = process_collector.fetch_binnary_ctx(e->tgid);
-	if (!binary_ctx) {
-		printf("fetch_binnary_ctx failed\n");
+	memset(ip, 0, sizeof(ip));
+	if (e->kernel_stackid < 0 || stack_drainer.lookup(e->kernel_stackid, ip))
 		return 0;
-	}
 
-	for (int idx = 0; idx < CONFIG_MAX_STACK_DEPTH; ++idx) {
-		if (!tmp.ip[idx])
-			break;
-		binary_addr_to_line(binary_ctx, tmp.ip[idx], stack_trace_callback, &idx);
+	for (int idx = 0; idx < CONFIG_MAX_STACK_DEPTH && ip[idx]; ++idx) {
+		std::string name = profile_collector.kernel_symbol(ip[idx]);
+		printf("#%d %p at %s [kernel]\n", idx, (void *)ip[idx], name.empty() ? "[unknown]" : name.data());
 	}
 	printf("\n");
+	return 0;
+}
+
+static int handle_request_cpu_event(void *ctx, void *data, size_t len)
+{
+	struct event_request_cpu *e = (struct event_request_cpu *)data;
+
+	struct timespec now;
+	clock_get_event_time(e->nsec, &now);
 
+	struct tm t;
+	char date_time[32];
+	strftime(date_time, sizeof(date_time), "%Y-%m-%d %H:%M:%S", localtime_r(&now.tv_sec, &t));
+	printf("[%s.%09lu] request_cpu: tgid=%d pid=%d coid=%llu comm=%s trace_id=%016llx oncpu=%llu duration=%llu\n", date_time, now.tv_nsec, e->tgid, e->pid, e->coid,
+	       e->comm, e->trace_id, e->oncpu_ns, e->duration);
 	return 0;
 }
 
@@ -194,6 +357,9 @@ static int handle_sched_event(void *ctx, void *data, size_t len)
 		break;
 	case 2: // exit
 		process_collector.delete_process_item(e->pid);
+		// 进程号被复用后不能沿用旧进程的 _PyRuntime 偏移
+		python_unwinder.disable(skel, e->pid);
+		python_unwinder.forget(e->pid);
 		break;
 	}
 	return 0;
@@ -243,11 +409,46 @@ static int handle_tcp_probe_event(void *ctx, void *data, size_t len)
 	return 0;
 }
 
+// 内核产生事件时记录的时间戳,部分事件没有时间戳,返回 0
+static unsigned long long event_nsec(unsigned int type, void *data)
+{
+	switch (type) {
+	case RB_EVENT_LOG:
+		return ((struct event_log *)data)->nsec;
+	case RB_EVENT_USER_CALL_STACK:
+		return ((struct event_user_call_stack *)data)->nsec;
+	case RB_EVENT_OFFCPU_CALL_STACK:
+		return ((struct event_offcpu_call_stack *)data)->nsec;
+	case RB_EVENT_USER_CALL_STACK_INLINE:
+		return ((struct event_user_call_stack_inline *)data)->nsec;
+	case RB_EVENT_OFFCPU_CALL_STACK_INLINE:
+		return ((struct event_offcpu_call_stack_inline *)data)->nsec;
+	case RB_EVENT_PYTHON_CALL_STACK:
+		return ((struct event_python_call_stack *)data)->nsec;
+	case RB_EVENT_USER_STACK_SNAPSHOT:
+		return ((struct event_user_stack_snapshot *)data)->nsec;
+	case RB_EVENT_TCP_PROBE:
+		return ((struct event_tcp_probe *)data)->nsec;
+	case RB_EVENT_IO_OUTLIER:
+		return ((struct event_io_outlier *)data)->nsec;
+	case RB_EVENT_REQUEST_CPU:
+		return ((struct event_request_cpu *)data)->nsec;
+	default:
+		return 0;
+	}
+}
+
 int ring_buffer_callback(void *ctx, void *data, size_t len)
 {
 	assert(len >= sizeof(unsigned int));
 	unsigned int type = *(unsigned int *)data;
 
+	uint64_t begin = boottime_ns();
+	unsigned long long nsec = event_nsec(type, data);
+	if (nsec) {
+		metrics.observe_delay(nsec, begin);
+	}
+
 	switch (type) {
 	case RB_EVENT_UNSPEC:
 		break;
@@ -260,14 +461,34 @@ int ring_buffer_callback(void *ctx, void *data, size_t len)
 	case RB_EVENT_OFFCPU_CALL_STACK:
 		handle_offcpu_call_stack_event(ctx, data, len);
 		break;
+	case RB_EVENT_USER_CALL_STACK_INLINE:
+		handle_user_call_stack_inline_event(ctx, data, len);
+		break;
+	case RB_EVENT_OFFCPU_CALL_STACK_INLINE:
+		handle_offcpu_call_stack_inline_event(ctx, data, len);
+		break;
+	case RB_EVENT_PYTHON_CALL_STACK:
+		handle_python_call_stack_event(ctx, data, len);
+		break;
+	case RB_EVENT_USER_STACK_SNAPSHOT:
+		handle_user_stack_snapshot_event(ctx, data, len);
+		break;
 	case RB_EVENT_SCHED:
 		handle_sched_event(ctx, data, len);
 		break;
 	case RB_EVENT_TCP_PROBE:
 		handle_tcp_probe_event(ctx, data, len);
 		break;
+	case RB_EVENT_IO_OUTLIER:
+		handle_io_outlier_event(ctx, data, len);
+		break;
+	case RB_EVENT_REQUEST_CPU:
+		handle_request_cpu_event(ctx, data, len);
+		break;
 	default:
 		break;
 	}
+
+	metrics.observe_event(type, boottime_ns() - begin);
 	return 0;
 }
@@ -0,0 +1,469 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/cfi.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+// x86_64 的 DWARF 寄存器编号
+static const unsigned int DWARF_REG_RBP = 6;
+static const unsigned int DWARF_REG_RSP = 7;
+
+// 指针编码,见 LSB 中 .eh_frame 的说明
+static const uint8_t DW_EH_PE_omit = 0xff;
+static const uint8_t DW_EH_PE_pcrel = 0x10;
+
+// 顺序读取 .eh_frame, 越界后只返回 0 并记录错误
+struct cfi_reader {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	uint64_t vma;
+	bool error;
+
+	template <typename T> T read()
+	{
+		T value = 0;
+		if (pos + sizeof(T) > size) {
+			error = true;
+			pos = size;
+			return 0;
+		}
+		memcpy(&value, data + pos, sizeof(T));
+		pos += sizeof(T);
+		return value;
+	}
+
+	uint64_t uleb()
+	{
+		uint64_t value = 0;
+		unsigned int shift = 0;
+		while (true) {
+			uint8_t byte = read<uint8_t>();
+			if (error)
+				return 0;
+			if (shift < 64)
+				value |= (uint64_t)(byte & 0x7f) << shift;
+			shift += 7;
+			if (!(byte & 0x80))
+				return value;
+		}
+	}
+
+	int64_t sleb()
+	{
+		int64_t value = 0;
+		unsigned int shift = 0;
+		uint8_t byte;
+		do {
+			byte = read<uint8_t>();
+			if (error)
+				return 0;
+			if (shift < 64)
+				value |= (int64_t)(byte & 0x7f) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+		if (shift < 64 && (byte & 0x40))
+			value |= -((int64_t)1 << shift);
+		return value;
+	}
+
+	// 只支持 absptr 和 pcrel, 其他编码在 .eh_frame 的 FDE 中很少出现
+	uint64_t encoded(uint8_t encoding)
+	{
+		if (encoding == DW_EH_PE_omit)
+			return 0;
+
+		uint64_t field = vma + pos;
+		uint64_t value;
+		switch (encoding & 0x0f) {
+		case 0x00:
+		case 0x04:
+			value = read<uint64_t>();
+			break;
+		case 0x01:
+			value = uleb();
+			break;
+		case 0x02:
+			value = read<uint16_t>();
+			break;
+		case 0x03:
+			value = read<uint32_t>();
+			break;
+		case 0x09:
+			value = sleb();
+			break;
+		case 0x0a:
+			value = read<int16_t>();
+			break;
+		case 0x0b:
+			value = read<int32_t>();
+			break;
+		case 0x0c:
+			value = read<int64_t>();
+			break;
+		default:
+			error = true;
+			return 0;
+		}
+
+		switch (encoding & 0x70) {
+		case 0x00:
+			return value;
+		case DW_EH_PE_pcrel:
+			return value + field;
+		default:
+			error = true;
+			return 0;
+		}
+	}
+};
+
+struct cfi_cie {
+	uint64_t code_align;
+	int64_t data_align;
+	uint8_t fde_encoding;
+	bool augmentation;
+	size_t instructions;
+	size_t end;
+	bool valid;
+};
+
+// CFA 规则的执行状态, rbp 只记录保存在 CFA 偏移处的情况
+struct cfi_state {
+	uint8_t cfa_reg;
+	int64_t cfa_offset;
+	bool cfa_valid;
+	bool rbp_saved;
+	int64_t rbp_offset;
+};
+
+static struct cfi_cie parse_cie(const uint8_t *data, size_t size, uint64_t vma, size_t offset)
+{
+	struct cfi_cie cie = {};
+	struct cfi_reader reader = { data, size, offset, vma, false };
+
+	uint64_t length = reader.read<uint32_t>();
+	if (length == 0xffffffff)
+		length = reader.read<uint64_t>();
+	cie.end = reader.pos + length;
+	if (reader.error || cie.end > size || reader.read<uint32_t>() != 0)
+		return cie;
+
+	uint8_t version = reader.read<uint8_t>();
+	std::string augmentation;
+	while (char c = reader.read<uint8_t>())
+		augmentation.push_back(c);
+	if (augmentation.find("eh") != std::string::npos)
+		reader.read<uint64_t>();
+
+	cie.code_align = reader.uleb();
+	cie.data_align = reader.sleb();
+	if (version == 1)
+		reader.read<uint8_t>();
+	else
+		reader.uleb();
+
+	if (!augmentation.empty() && augmentation[0] == 'z') {
+		cie.augmentation = true;
+		uint64_t len = reader.uleb();
+		size_t end = reader.pos + len;
+		for (size_t idx = 1; idx < augmentation.size() && !reader.error; ++idx) {
+			if (augmentation[idx] == 'R') {
+				cie.fde_encoding = reader.read<uint8_t>();
+			} else if (augmentation[idx] == 'P') {
+				// personality 可能是间接编码,这里只需要跳过
+				uint8_t encoding = reader.read<uint8_t>();
+				reader.encoded(encoding & 0x0f);
+			} else if (augmentation[idx] == 'L') {
+				reader.read<uint8_t>();
+			} else if (augmentation[idx] != 'S' && augmentation[idx] != 'B') {
+				break;
+			}
+		}
+		reader.pos = end;
+	}
+
+	cie.instructions = reader.pos;
+	cie.valid = !reader.error && cie.instructions <= cie.end;
+	return cie;
+}
+
+static void set_rbp(struct cfi_state &state, unsigned int reg, bool saved, int64_t offset)
+{
+	if (reg != DWARF_REG_RBP)
+		return;
+	state.rbp_saved = saved;
+	state.rbp_offset = offset;
+}
+
+// 执行 [begin, end) 中的指令. rows 为 NULL 时只计算初始状态,否则在位置前进时输出一行
+static bool execute(const uint8_t *data, size_t begin, size_t end, uint64_t vma, const struct cfi_cie &cie, const struct cfi_state &initial,
+		    struct cfi_state &state, uint64_t &loc, std::vector<struct cfi_row> *rows)
+{
+	struct cfi_reader reader = { data, end, begin, vma, false };
+	std::vector<struct cfi_state> remembered;
+
+	auto advance = [&](uint64_t next) {
+		if (!rows)
+			return;
+		struct cfi_row row = {};
+		row.pc = loc;
+		row.cfa_reg = state.cfa_reg;
+		row.cfa_offset = state.cfa_offset;
+		row.rbp_offset = state.rbp_offset;
+		row.flags = (state.cfa_valid && (state.cfa_reg == DWARF_REG_RSP || state.cfa_reg == DWARF_REG_RBP) ? CFI_ROW_VALID : 0) |
+			    (state.rbp_saved ? CFI_ROW_RBP_SAVED : 0);
+		if (!rows->empty() && rows->back().pc == row.pc)
+			rows->back() = row;
+		else
+			rows->push_back(row);
+		loc = next;
+	};
+
+	while (reader.pos < end && !reader.error) {
+		uint8_t op = reader.read<uint8_t>();
+		uint8_t low = op & 0x3f;
+		unsigned int reg;
+
+		switch (op & 0xc0) {
+		case 0x40: // DW_CFA_advance_loc
+			advance(loc + low * cie.code_align);
+			continue;
+		case 0x80: // DW_CFA_offset
+			set_rbp(state, low, true, (int64_t)reader.uleb() * cie.data_align);
+			continue;
+		case 0xc0: // DW_CFA_restore
+			set_rbp(state, low, initial.rbp_saved, initial.rbp_offset);
+			continue;
+		}
+
+		switch (op) {
+		case 0x00: // DW_CFA_nop
+			break;
+		case 0x01: // DW_CFA_set_loc
+			advance(reader.encoded(cie.fde_encoding));
+			break;
+		case 0x02: // DW_CFA_advance_loc1
+			advance(loc + reader.read<uint8_t>() * cie.code_align);
+			break;
+		case 0x03: // DW_CFA_advance_loc2
+			advance(loc + reader.read<uint16_t>() * cie.code_align);
+			break;
+		case 0x04: // DW_CFA_advance_loc4
+			advance(loc + reader.read<uint32_t>() * cie.code_align);
+			break;
+		case 0x05: // DW_CFA_offset_extended
+			reg = reader.uleb();
+			set_rbp(state, reg, true, (int64_t)reader.uleb() * cie.data_align);
+			break;
+		case 0x06: // DW_CFA_restore_extended
+			set_rbp(state, reader.uleb(), initial.rbp_saved, initial.rbp_offset);
+			break;
+		case 0x07: // DW_CFA_undefined
+		case 0x08: // DW_CFA_same_value
+			set_rbp(state, reader.uleb(), false, 0);
+			break;
+		case 0x09: // DW_CFA_register
+			reg = reader.uleb();
+			reader.uleb();
+			set_rbp(state, reg, false, 0);
+			break;
+		case 0x0a: // DW_CFA_remember_state
+			remembered.push_back(state);
+			break;
+		case 0x0b: // DW_CFA_restore_state
+			if (remembered.empty())
+				return false;
+			state = remembered.back();
+			remembered.pop_back();
+			break;
+		case 0x0c: // DW_CFA_def_cfa
+			state.cfa_reg = reader.uleb();
+			state.cfa_offset = reader.uleb();
+			state.cfa_valid = true;
+			break;
+		case 0x0d: // DW_CFA_def_cfa_register
+			state.cfa_reg = reader.uleb();
+			break;
+		case 0x0e: // DW_CFA_def_cfa_offset
+			state.cfa_offset = reader.uleb();
+			break;
+		case 0x0f: // DW_CFA_def_cfa_expression, 例如 PLT, 不支持
+			reader.pos += reader.uleb();
+			state.cfa_valid = false;
+			break;
+		case 0x10: // DW_CFA_expression
+		case 0x16: // DW_CFA_val_expression
+			reg = reader.uleb();
+			reader.pos += reader.uleb();
+			set_rbp(state, reg, false, 0);
+			break;
+		case 0x11: // DW_CFA_offset_extended_sf
+			reg = reader.uleb();
+			set_rbp(state, reg, true, reader.sleb() * cie.data_align);
+			break;
+		case 0x12: // DW_CFA_def_cfa_sf
+			state.cfa_reg = reader.uleb();
+			state.cfa_offset = reader.sleb() * cie.data_align;
+			state.cfa_valid = true;
+			break;
+		case 0x13: // DW_CFA_def_cfa_offset_sf
+			state.cfa_offset = reader.sleb() * cie.data_align;
+			break;
+		case 0x14: // DW_CFA_val_offset
+			reg = reader.uleb();
+			reader.uleb();
+			set_rbp(state, reg, false, 0);
+			break;
+		case 0x15: // DW_CFA_val_offset_sf
+			reg = reader.uleb();
+			reader.sleb();
+			set_rbp(state, reg, false, 0);
+			break;
+		case 0x2e: // DW_CFA_GNU_args_size
+			reader.uleb();
+			break;
+		case 0x2f: // DW_CFA_GNU_negative_offset_extended
+			reg = reader.uleb();
+			set_rbp(state, reg, true, -(int64_t)reader.uleb() * cie.data_align);
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return !reader.error;
+}
+
+int cfi_table::parse(const uint8_t *data, size_t size, uint64_t vma)
+{
+	std::unordered_map<size_t, struct cfi_cie> cies;
+	size_t pos = 0;
+
+	while (pos + 4 <= size) {
+		struct cfi_reader reader = { data, size, pos, vma, false };
+		uint64_t length = reader.read<uint32_t>();
+		if (length == 0)
+			break;
+		if (length == 0xffffffff)
+			length = reader.read<uint64_t>();
+		size_t end = reader.pos + length;
+		if (reader.error || end > size)
+			return -1;
+
+		size_t id_pos = reader.pos;
+		uint32_t id = reader.read<uint32_t>();
+		pos = end;
+		if (id == 0 || id > id_pos)
+			continue;
+
+		size_t cie_offset = id_pos - id;
+		auto it = cies.find(cie_offset);
+		if (it == cies.end())
+			it = cies.emplace(cie_offset, parse_cie(data, size, vma, cie_offset)).first;
+		const struct cfi_cie &cie = it->second;
+		if (!cie.valid)
+			continue;
+
+		uint64_t pc_begin = reader.encoded(cie.fde_encoding);
+		uint64_t pc_range = reader.encoded(cie.fde_encoding & 0x0f);
+		if (cie.augmentation)
+			reader.pos += reader.uleb();
+		if (reader.error || reader.pos > end)
+			continue;
+
+		struct cfi_state initial = {};
+		uint64_t loc = pc_begin;
+		if (!execute(data, cie.instructions, cie.end, vma, cie, initial, initial, loc, NULL))
+			continue;
+
+		// 指令解析失败时保留已经输出的行,之后的范围没有规则
+		struct cfi_state state = initial;
+		std::vector<struct cfi_row> rows;
+		execute(data, reader.pos, end, vma, cie, initial, state, loc, &rows);
+		struct cfi_row last = {};
+		last.pc = loc;
+		last.cfa_reg = state.cfa_reg;
+		last.cfa_offset = state.cfa_offset;
+		last.rbp_offset = state.rbp_offset;
+		last.flags = (state.cfa_valid && (state.cfa_reg == DWARF_REG_RSP || state.cfa_reg == DWARF_REG_RBP) ? CFI_ROW_VALID : 0) |
+			     (state.rbp_saved ? CFI_ROW_RBP_SAVED : 0);
+		if (!rows.empty() && rows.back().pc == last.pc)
+			rows.back() = last;
+		else if (last.pc < pc_begin + pc_range)
+			rows.push_back(last);
+
+		// 函数结束后到下一个函数之前没有规则
+		struct cfi_row terminator = {};
+		terminator.pc = pc_begin + pc_range;
+		rows.push_back(terminator);
+		rows_.insert(rows_.end(), rows.begin(), rows.end());
+	}
+
+	// 相同位置上函数的起始行排在前一个函数的结束行之后,查找时取最后一个不大于 pc 的行
+	std::stable_sort(rows_.begin(), rows_.end(), [](const struct cfi_row &a, const struct cfi_row &b) {
+		return a.pc < b.pc || (a.pc == b.pc && !(a.flags & CFI_ROW_VALID) && (b.flags & CFI_ROW_VALID));
+	});
+
+	// 合并规则相同的相邻行
+	auto same = [](const struct cfi_row &a, const struct cfi_row &b) {
+		return a.flags == b.flags && a.cfa_reg == b.cfa_reg && a.cfa_offset == b.cfa_offset && a.rbp_offset == b.rbp_offset;
+	};
+	rows_.erase(std::unique(rows_.begin(), rows_.end(), same), rows_.end());
+	rows_.shrink_to_fit();
+	return 0;
+}
+
+const struct cfi_row *cfi_table::lookup(uint64_t pc) const
+{
+	auto it = std::upper_bound(rows_.begin(), rows_.end(), pc, [](uint64_t pc, const struct cfi_row &row) { return pc < row.pc; });
+	if (it == rows_.begin())
+		return NULL;
+	--it;
+	return (it->flags & CFI_ROW_VALID) ? &*it : NULL;
+}
+
+int cfi_unwind(const class cfi_table *table, uint64_t bias, struct cfi_regs regs, const uint8_t *stack, size_t size, uintptr_t *ip, int max)
+{
+	const uint64_t base = regs.sp;
+	auto read = [&](uint64_t addr, uint64_t &value) {
+		if (addr < base || addr + sizeof(value) > base + size)
+			return false;
+		memcpy(&value, stack + (addr - base), sizeof(value));
+		return true;
+	};
+
+	int nr = 0;
+	while (nr < max && regs.ip) {
+		ip[nr++] = regs.ip;
+
+		// 返回地址指向 call 的下一条指令,可能已经超出调用者的范围,查找时减一. 第一帧的地址是精确的
+		uint64_t pc = nr == 1 ? regs.ip : regs.ip - 1;
+		const struct cfi_row *row = table && pc >= bias ? table->lookup(pc - bias) : NULL;
+
+		uint64_t cfa, ra;
+		if (row) {
+			cfa = (row->cfa_reg == DWARF_REG_RSP ? regs.sp : regs.bp) + row->cfa_offset;
+			if (!read(cfa - 8, ra))
+				break;
+			if ((row->flags & CFI_ROW_RBP_SAVED) && !read(cfa + row->rbp_offset, regs.bp))
+				break;
+		} else {
+			// [bp] 为调用者的 bp, [bp + 8] 为返回地址
+			uint64_t bp;
+			cfa = regs.bp + 16;
+			if (!read(regs.bp + 8, ra) || !read(regs.bp, bp))
+				break;
+			regs.bp = bp;
+		}
+
+		// 栈只会向高地址展开,避免规则错误时死循环
+		if (cfa <= regs.sp)
+			break;
+		regs.sp = cfa;
+		regs.ip = ra;
+	}
+
+	return nr;
+}
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_CFI_H
+#define HIJACK_CFI_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum {
+	CFI_ROW_VALID = 1,
+	// rbp 保存在 CFA + rbp_offset 处,否则保持不变
+	CFI_ROW_RBP_SAVED = 2,
+};
+
+// .eh_frame 中 CFA 规则展开后的一行,从 pc 开始到下一行之前有效. 只保留 x86_64 上展开需要的 CFA、返回地址和 rbp
+struct cfi_row {
+	uint64_t pc;
+	int32_t cfa_offset;
+	int32_t rbp_offset;
+	uint8_t cfa_reg;
+	uint8_t flags;
+};
+
+// 展开时使用的寄存器,与 pt_regs 中的用户态寄存器一致
+struct cfi_regs {
+	uint64_t ip;
+	uint64_t sp;
+	uint64_t bp;
+};
+
+// 每个二进制只解析一次,按 pc 排序后二分查找
+class cfi_table {
+    public:
+	// data 为 .eh_frame 的内容, vma 为其虚拟地址,用于计算 pc 相对的编码
+	int parse(const uint8_t *data, size_t size, uint64_t vma);
+
+	// pc 为文件中的虚拟地址,没有对应的规则时返回 NULL
+	const struct cfi_row *lookup(uint64_t pc) const;
+
+	size_t size() const
+	{
+		return rows_.size();
+	}
+
+    private:
+	std::vector<struct cfi_row> rows_;
+};
+
+// 根据用户栈的快照展开调用栈, stack 为从 regs.sp 开始的 size 字节, bias 为运行地址与文件中虚拟地址的差.
+// table 中找不到规则的栈帧(例如动态库中的函数)按帧指针展开,返回写入 ip 的地址数量
+int cfi_unwind(const class cfi_table *table, uint64_t bias, struct cfi_regs regs, const uint8_t *stack, size_t size, uintptr_t *ip, int max);
+
+#endif
@@ -1,8 +1,15 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "hijack/control.h"
 #include "hijack-common/types.h"
+#include "hijack/governor.h"
+#include "hijack/metrics.h"
 #include "hijack/process.h"
+#include "hijack/profile.h"
+#include "hijack/prog_stats.h"
+#include "hijack/python.h"
+#include "hijack/utils.h"
 #include "hijack/hijack.skel.h"
+#include <algorithm>
 #include <bpf/bpf.h>
 #include <cassert>
 #include <errno.h>
@@ -10,12 +17,31 @@
 #include <sys/sdt.h>
 #endif
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/un.h>
 #include <thread>
 #include <unistd.h>
+#include <vector>
 
 extern struct hijack *skel;
 extern class process_collector process_collector;
+extern class metrics metrics;
+extern class prog_stats prog_stats;
+extern class governor governor;
+extern class profile_collector profile_collector;
+extern class python_unwinder python_unwinder;
+
+// cgroup v2 中 cgroup id 就是目录的 inode 编号,不以 / 开头的路径相对于 cgroup 挂载点
+static int fetch_cgroup_id(const char *cgroup, uint64_t *cgroup_id)
+{
+	std::string path = cgroup[0] == '/' ? cgroup : current_cgroup_mount_path() + "/" + cgroup;
+	struct stat st;
+	if (stat(path.data(), &st))
+		return -errno;
+
+	*cgroup_id = st.st_ino;
+	return 0;
+}
 
 int control::handle_pproc_enabled(void *buffer, int len)
 {
@@ -236,8 +262,221 @@ int control::handle_sched_switch_event_enabled(void *buffer, int len)
 		bpf_map_update_elem(bpf_map__fd(skel->maps.sched_switch_event_map), &event->pid, &empty, BPF_ANY);
 	} else {
 		bpf_map_delete_elem(bpf_map__fd(skel->maps.sched_switch_event_map), &event->pid);
+		bpf_map_delete_elem(bpf_map__fd(skel->maps.offcpu_call_stack_inline_map), &event->pid);
+	}
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_metrics(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_metrics));
+
+	struct ctl_metrics *event = (struct ctl_metrics *)buffer;
+	metrics.snapshot(event);
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_prog_stats(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_prog_stats));
+
+	struct ctl_prog_stats *event = (struct ctl_prog_stats *)buffer;
+	std::vector<struct prog_stat> stats = prog_stats.snapshot();
+
+	event->nr = 0;
+	for (auto const &stat : stats) {
+		if (event->nr >= CONFIG_PROG_STATS_MAX)
+			break;
+
+		struct ctl_prog_stat *ctl = &event->stats[event->nr++];
+		memset(ctl, 0, sizeof(*ctl));
+		strncpy(ctl->name, stat.name.data(), sizeof(ctl->name) - 1);
+		ctl->run_cnt = stat.run_cnt;
+		ctl->run_time_ns = stat.run_time_ns;
+		ctl->ns_per_run = stat.ns_per_run;
+		ctl->cpu_share_ppm = stat.cpu_share_ppm;
+	}
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_governor(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_governor));
+
+	struct ctl_governor *event = (struct ctl_governor *)buffer;
+	if (event->budget_ppm) {
+		governor.set_budget_ppm(event->budget_ppm);
+	}
+	governor.set_enabled(event->enabled);
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_call_stack_inline_depth(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_call_stack_inline_depth));
+
+	struct ctl_call_stack_inline_depth *event = (struct ctl_call_stack_inline_depth *)buffer;
+
+	int zero = 0;
+	struct global_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg);
+
+	if (event->call_stack_depth >= 0)
+		cfg.call_stack_inline_depth = std::min(event->call_stack_depth, CONFIG_MAX_STACK_DEPTH);
+	if (event->handle_mm_fault_depth >= 0)
+		cfg.handle_mm_fault_inline_depth = std::min(event->handle_mm_fault_depth, CONFIG_MAX_STACK_DEPTH);
+	if (event->offcpu_depth >= 0)
+		cfg.offcpu_inline_depth = std::min(event->offcpu_depth, CONFIG_MAX_STACK_DEPTH);
+	bpf_map_update_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg, BPF_ANY);
+
+	// 返回生效后的配置
+	event->call_stack_depth = cfg.call_stack_inline_depth;
+	event->handle_mm_fault_depth = cfg.handle_mm_fault_inline_depth;
+	event->offcpu_depth = cfg.offcpu_inline_depth;
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_offcpu_aggregate_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_offcpu_aggregate_enabled));
+
+	struct ctl_offcpu_aggregate_enabled *event = (struct ctl_offcpu_aggregate_enabled *)buffer;
+
+	int zero = 0;
+	struct global_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg);
+
+	cfg.offcpu_aggregate_enabled = event->offcpu_aggregate_enabled;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg, BPF_ANY);
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_oncpu_sample(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_oncpu_sample));
+
+	struct ctl_oncpu_sample *event = (struct ctl_oncpu_sample *)buffer;
+	event->cgroup[sizeof(event->cgroup) - 1] = '\0';
+
+	if (event->tgid > 0) {
+		struct pproc_cfg cfg = {};
+		bpf_map_lookup_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg);
+		cfg.oncpu_sample_enabled = event->enabled;
+		bpf_map_update_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg, BPF_ANY);
+	}
+
+	if (event->cgroup[0]) {
+		uint64_t cgroup_id;
+		event->ret = fetch_cgroup_id(event->cgroup, &cgroup_id);
+		if (event->ret)
+			return 0;
+
+		struct pproc_cfg cfg = {};
+		bpf_map_lookup_elem(bpf_map__fd(skel->maps.cgroup_cfg_map), &cgroup_id, &cfg);
+		cfg.oncpu_sample_enabled = event->enabled;
+		bpf_map_update_elem(bpf_map__fd(skel->maps.cgroup_cfg_map), &cgroup_id, &cfg, BPF_ANY);
 	}
 
+	event->ret = 0;
+	if (event->frequency > 0) {
+		event->ret = profile_collector.start_oncpu_sample(event->frequency);
+	} else if (event->frequency < 0) {
+		profile_collector.stop_oncpu_sample();
+	} else if (event->enabled && !profile_collector.oncpu_sample_running()) {
+		event->ret = profile_collector.start_oncpu_sample(CONFIG_ONCPU_SAMPLE_FREQUENCY);
+	}
+	return 0;
+}
+
+int control::handle_pprof_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_pprof_enabled));
+
+	struct ctl_pprof_enabled *event = (struct ctl_pprof_enabled *)buffer;
+	profile_collector.set_pprof_enabled(event->pprof_enabled);
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_offcpu_filter(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_offcpu_filter));
+
+	struct ctl_offcpu_filter *event = (struct ctl_offcpu_filter *)buffer;
+
+	int zero = 0;
+	struct global_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg);
+
+	cfg.offcpu_min_duration = event->offcpu_min_duration;
+	cfg.offcpu_state_mask = event->offcpu_state_mask;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg, BPF_ANY);
+
+	event->ret = 0;
+	return 0;
+}
+
+// 检查是否还有进程或者 cgroup 开启了 sched_switch_enabled
+template <typename K> static bool sched_switch_scope_exists(int fd)
+{
+	K key, next_key;
+	K *prev = NULL;
+	while (!bpf_map_get_next_key(fd, prev, &next_key)) {
+		struct pproc_cfg cfg = {};
+		if (!bpf_map_lookup_elem(fd, &next_key, &cfg) && cfg.sched_switch_enabled)
+			return true;
+		key = next_key;
+		prev = &key;
+	}
+	return false;
+}
+
+int control::handle_sched_switch_scope_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_sched_switch_scope_enabled));
+
+	struct ctl_sched_switch_scope_enabled *event = (struct ctl_sched_switch_scope_enabled *)buffer;
+	event->cgroup[sizeof(event->cgroup) - 1] = '\0';
+
+	if (event->tgid > 0) {
+		struct pproc_cfg cfg = {};
+		bpf_map_lookup_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg);
+		cfg.sched_switch_enabled = event->enabled;
+		bpf_map_update_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg, BPF_ANY);
+	}
+
+	if (event->cgroup[0]) {
+		uint64_t cgroup_id;
+		event->ret = fetch_cgroup_id(event->cgroup, &cgroup_id);
+		if (event->ret)
+			return 0;
+
+		struct pproc_cfg cfg = {};
+		bpf_map_lookup_elem(bpf_map__fd(skel->maps.cgroup_cfg_map), &cgroup_id, &cfg);
+		cfg.sched_switch_enabled = event->enabled;
+		bpf_map_update_elem(bpf_map__fd(skel->maps.cgroup_cfg_map), &cgroup_id, &cfg, BPF_ANY);
+	}
+
+	int zero = 0;
+	struct global_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg);
+	cfg.sched_switch_scope_enabled = sched_switch_scope_exists<int>(bpf_map__fd(skel->maps.pproc_cfg_map)) ||
+					 sched_switch_scope_exists<uint64_t>(bpf_map__fd(skel->maps.cgroup_cfg_map));
+	bpf_map_update_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg, BPF_ANY);
+
+	// 关闭后已经创建的线程配置不会自动删除,与逐个线程开启的方式一样通过 CTL_EVENT_SCHED_SWITCH_EVENT_ENABLED 删除,或者等待线程退出
 	event->ret = 0;
 	return 0;
 }
@@ -256,6 +495,253 @@ int control::init_socket_fd()
 	return 0;
 }
 
+int control::handle_runq_latency_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_runq_latency_enabled));
+
+	struct ctl_runq_latency_enabled *event = (struct ctl_runq_latency_enabled *)buffer;
+
+	int zero = 0;
+	struct global_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg);
+
+	cfg.runq_latency_enabled = event->runq_latency_enabled;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg, BPF_ANY);
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_cpu_account_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_cpu_account_enabled));
+
+	struct ctl_cpu_account_enabled *event = (struct ctl_cpu_account_enabled *)buffer;
+
+	int zero = 0;
+
+	// 关闭期间 oncpu_start_map 中的时间已经过期,重新开启前清空,避免把关闭期间的时间算作运行时间.
+	// PERCPU map 中每个 CPU 的值按 8 字节对齐
+	int ncpus = libbpf_num_possible_cpus();
+	if (event->cpu_account_enabled && ncpus > 0) {
+		std::vector<char> starts(ncpus * ((sizeof(struct oncpu_start) + 7) / 8 * 8));
+		bpf_map_update_elem(bpf_map__fd(skel->maps.oncpu_start_map), &zero, starts.data(), BPF_ANY);
+	}
+
+	struct global_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg);
+
+	cfg.cpu_account_enabled = event->cpu_account_enabled;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg, BPF_ANY);
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_lock_event_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_lock_event_enabled));
+
+	struct ctl_lock_event_enabled *event = (struct ctl_lock_event_enabled *)buffer;
+	struct pproc_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg);
+
+	cfg.lock_event_enabled = event->lock_event_enabled;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg, BPF_ANY);
+
+	if (event->lock_event_enabled) {
+		process_collector.hook_lock_probe(event->tgid, skel);
+	} else {
+		process_collector.unhook_lock_probe(event->tgid, skel);
+	}
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_handle_mm_fault_aggregate(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_handle_mm_fault_aggregate));
+
+	struct ctl_handle_mm_fault_aggregate *event = (struct ctl_handle_mm_fault_aggregate *)buffer;
+
+	int zero = 0;
+	struct global_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg);
+
+	cfg.handle_mm_fault_aggregate_enabled = event->enabled;
+	cfg.handle_mm_fault_sample_period = event->sample_period;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.global_cfg_map), &zero, &cfg, BPF_ANY);
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_go_offcpu_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_go_offcpu_enabled));
+
+	struct ctl_go_offcpu_enabled *event = (struct ctl_go_offcpu_enabled *)buffer;
+	struct pproc_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg);
+
+	cfg.go_offcpu_enabled = event->go_offcpu_enabled;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg, BPF_ANY);
+
+	if (event->go_offcpu_enabled) {
+		process_collector.hook_go_offcpu_probe(event->tgid, skel);
+	} else {
+		process_collector.unhook_go_offcpu_probe(event->tgid, skel);
+	}
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_go_sched_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_go_sched_enabled));
+
+	struct ctl_go_sched_enabled *event = (struct ctl_go_sched_enabled *)buffer;
+	struct pproc_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg);
+
+	cfg.go_sched_enabled = event->go_sched_enabled;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg, BPF_ANY);
+
+	// 开启后 newproc1/goexit1 维护增量,初始值在开启后从运行时的 allgs 中读取, 开启和读取之间创建的协程可能重复计数
+	if (event->go_sched_enabled) {
+		process_collector.hook_go_sched_probe(event->tgid, skel);
+		long count = process_collector.count_go_goroutines(event->tgid);
+		if (count >= 0) {
+			int64_t value = count;
+			bpf_map_update_elem(bpf_map__fd(skel->maps.go_goroutines_map), &event->tgid, &value, BPF_ANY);
+		} else {
+			printf("count goroutines failed: tgid=%d\n", event->tgid);
+		}
+	} else {
+		process_collector.unhook_go_sched_probe(event->tgid, skel);
+		bpf_map_delete_elem(bpf_map__fd(skel->maps.go_goroutines_map), &event->tgid);
+	}
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_malloc_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_malloc_enabled));
+
+	struct ctl_malloc_enabled *event = (struct ctl_malloc_enabled *)buffer;
+	struct pproc_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg);
+
+	cfg.malloc_enabled = event->malloc_enabled;
+	cfg.malloc_sample_bytes = event->sample_bytes;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg, BPF_ANY);
+
+	if (event->malloc_enabled) {
+		process_collector.hook_malloc_probe(event->tgid, skel);
+	} else {
+		process_collector.unhook_malloc_probe(event->tgid, skel);
+		profile_collector.clear_malloc(event->tgid);
+	}
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_malloc_report(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_malloc_report));
+
+	struct ctl_malloc_report *event = (struct ctl_malloc_report *)buffer;
+	profile_collector.request_malloc_report(event->tgid);
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_go_malloc_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_go_malloc_enabled));
+
+	struct ctl_go_malloc_enabled *event = (struct ctl_go_malloc_enabled *)buffer;
+	struct pproc_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg);
+
+	cfg.go_malloc_enabled = event->go_malloc_enabled;
+	cfg.go_malloc_sample_bytes = event->sample_bytes;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg, BPF_ANY);
+
+	if (event->go_malloc_enabled) {
+		process_collector.hook_go_malloc_probe(event->tgid, skel);
+	} else {
+		process_collector.unhook_go_malloc_probe(event->tgid, skel);
+	}
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_python_unwind_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_python_unwind_enabled));
+
+	struct ctl_python_unwind_enabled *event = (struct ctl_python_unwind_enabled *)buffer;
+	if (event->enabled) {
+		event->ret = python_unwinder.enable(skel, event->tgid);
+	} else {
+		event->ret = python_unwinder.disable(skel, event->tgid);
+	}
+	return 0;
+}
+
+int control::handle_dwarf_unwind_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_dwarf_unwind_enabled));
+
+	struct ctl_dwarf_unwind_enabled *event = (struct ctl_dwarf_unwind_enabled *)buffer;
+	struct pproc_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg);
+
+	cfg.dwarf_unwind_enabled = event->enabled;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg, BPF_ANY);
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_io_outlier(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_io_outlier));
+
+	struct ctl_io_outlier *event = (struct ctl_io_outlier *)buffer;
+	struct pproc_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg);
+
+	cfg.io_outlier_ns = event->threshold_ns;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg, BPF_ANY);
+
+	event->ret = 0;
+	return 0;
+}
+
+int control::handle_request_cpu_enabled(void *buffer, int len)
+{
+	assert(len == sizeof(struct ctl_request_cpu_enabled));
+
+	struct ctl_request_cpu_enabled *event = (struct ctl_request_cpu_enabled *)buffer;
+	struct pproc_cfg cfg = {};
+	bpf_map_lookup_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg);
+
+	cfg.request_cpu_enabled = event->enabled;
+	bpf_map_update_elem(bpf_map__fd(skel->maps.pproc_cfg_map), &event->tgid, &cfg, BPF_ANY);
+
+	event->ret = 0;
+	return 0;
+}
+
 int control::serve()
 {
 	static const int CTL_TYPE_LEN = 4;
@@ -270,6 +756,7 @@ int control::serve()
 		size = recvfrom(socket_fd_, buffer, CONFIG_CTL_BUFFER_SIZE_MAX, 0, (struct sockaddr *)&peer, &len);
 		assert(size >= CTL_TYPE_LEN);
 
+		uint64_t begin = boottime_ns();
 		type = CTL_EVENT_UNSPEC;
 		memcpy(&type, buffer, CTL_TYPE_LEN);
 		switch (type) {
@@ -312,7 +799,74 @@ int control::serve()
 		case CTL_EVENT_SCHED_SWITCH_EVENT_ENABLED:
 			handle_sched_switch_event_enabled(buffer, size);
 			break;
+		case CTL_EVENT_METRICS:
+			handle_metrics(buffer, size);
+			break;
+		case CTL_EVENT_PROG_STATS:
+			handle_prog_stats(buffer, size);
+			break;
+		case CTL_EVENT_GOVERNOR:
+			handle_governor(buffer, size);
+			break;
+		case CTL_EVENT_CALL_STACK_INLINE_DEPTH:
+			handle_call_stack_inline_depth(buffer, size);
+			break;
+		case CTL_EVENT_OFFCPU_AGGREGATE_ENABLED:
+			handle_offcpu_aggregate_enabled(buffer, size);
+			break;
+		case CTL_EVENT_ONCPU_SAMPLE:
+			handle_oncpu_sample(buffer, size);
+			break;
+		case CTL_EVENT_PPROF_ENABLED:
+			handle_pprof_enabled(buffer, size);
+			break;
+		case CTL_EVENT_OFFCPU_FILTER:
+			handle_offcpu_filter(buffer, size);
+			break;
+		case CTL_EVENT_SCHED_SWITCH_SCOPE_ENABLED:
+			handle_sched_switch_scope_enabled(buffer, size);
+			break;
+		case CTL_EVENT_RUNQ_LATENCY_ENABLED:
+			handle_runq_latency_enabled(buffer, size);
+			break;
+		case CTL_EVENT_CPU_ACCOUNT_ENABLED:
+			handle_cpu_account_enabled(buffer, size);
+			break;
+		case CTL_EVENT_LOCK_EVENT_ENABLED:
+			handle_lock_event_enabled(buffer, size);
+			break;
+		case CTL_EVENT_HANDLE_MM_FAULT_AGGREGATE:
+			handle_handle_mm_fault_aggregate(buffer, size);
+			break;
+		case CTL_EVENT_GO_OFFCPU_ENABLED:
+			handle_go_offcpu_enabled(buffer, size);
+			break;
+		case CTL_EVENT_GO_SCHED_ENABLED:
+			handle_go_sched_enabled(buffer, size);
+			break;
+		case CTL_EVENT_MALLOC_ENABLED:
+			handle_malloc_enabled(buffer, size);
+			break;
+		case CTL_EVENT_MALLOC_REPORT:
+			handle_malloc_report(buffer, size);
+			break;
+		case CTL_EVENT_GO_MALLOC_ENABLED:
+			handle_go_malloc_enabled(buffer, size);
+			break;
+		case CTL_EVENT_PYTHON_UNWIND_ENABLED:
+			handle_python_unwind_enabled(buffer, size);
+			break;
+		case CTL_EVENT_DWARF_UNWIND_ENABLED:
+			handle_dwarf_unwind_enabled(buffer, size);
+			break;
+		case CTL_EVENT_IO_OUTLIER:
+			handle_io_outlier(buffer, size);
+			break;
+		case CTL_EVENT_REQUEST_CPU_ENABLED:
+			handle_request_cpu_enabled(buffer, size);
+			break;
 		}
+		metrics.observe_control(boottime_ns() - begin);
 #if CONFIG_USDT
 		DTRACE_PROBE2(hijack, control, buffer, size);
 #endif
@@ -22,6 +22,28 @@ class control {
 	int handle_set_listen_port(void *buffer, int len);
 	int handle_handle_mm_fault_enabled(void *buffer, int len);
 	int handle_sched_switch_event_enabled(void *buffer, int len);
+	int handle_metrics(void *buffer, int len);
+	int handle_prog_stats(void *buffer, int len);
+	int handle_governor(void *buffer, int len);
+	int handle_call_stack_inline_depth(void *buffer, int len);
+	int handle_offcpu_aggregate_enabled(void *buffer, int len);
+	int handle_oncpu_sample(void *buffer, int len);
+	int handle_pprof_enabled(void *buffer, int len);
+	int handle_offcpu_filter(void *buffer, int len);
+	int handle_sched_switch_scope_enabled(void *buffer, int len);
+	int handle_runq_latency_enabled(void *buffer, int len);
+	int handle_cpu_account_enabled(void *buffer, int len);
+	int handle_lock_event_enabled(void *buffer, int len);
+	int handle_handle_mm_fault_aggregate(void *buffer, int len);
+	int handle_go_offcpu_enabled(void *buffer, int len);
+	int handle_go_sched_enabled(void *buffer, int len);
+	int handle_malloc_enabled(void *buffer, int len);
+	int handle_malloc_report(void *buffer, int len);
+	int handle_go_malloc_enabled(void *buffer, int len);
+	int handle_python_unwind_enabled(void *buffer, int len);
+	int handle_dwarf_unwind_enabled(void *buffer, int len);
+	int handle_io_outlier(void *buffer, int len);
+	int handle_request_cpu_enabled(void *buffer, int len);
 
     private:
 	int init_socket_fd();
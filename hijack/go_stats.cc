@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/go_stats.h"
+#include "hijack/metrics.h"
+#include "hijack/utils.h"
+#include <bpf/libbpf.h>
+#include <cstdio>
+#include <vector>
+
+static const uint64_t NS_PER_SEC = 1000000000UL;
+
+int go_stats::start(struct hijack *skel)
+{
+	skel_ = skel;
+	last_drain_ns_ = boottime_ns();
+	return 0;
+}
+
+void go_stats::drain()
+{
+	uint64_t now = boottime_ns();
+	if (now - last_drain_ns_ < CONFIG_GO_STATS_INTERVAL * NS_PER_SEC)
+		return;
+	last_drain_ns_ = now;
+
+	drain_hist(skel_->maps.go_gc_interval_hist_map, "go gc interval");
+	drain_hist(skel_->maps.go_stw_hist_map, "go stw");
+	drain_hist(skel_->maps.go_sched_latency_hist_map, "go sched latency");
+	print_goroutines();
+}
+
+void go_stats::drain_hist(struct bpf_map *map, const char *name)
+{
+	std::vector<int> tgids;
+	std::vector<struct log2_hist> hists;
+	int ret = lookup_and_delete_all(bpf_map__fd(map), tgids, hists, CONFIG_PROCESS_NUMBER_MAX);
+	if (ret)
+		printf("%s lookup_and_delete_batch failed: %d\n", bpf_map__name(map), ret);
+
+	for (size_t idx = 0; idx < tgids.size(); ++idx) {
+		print_log2_hist(name, "tgid", tgids[idx], hists[idx]);
+	}
+}
+
+// 协程数量在开启时从运行时读取,之后由探针维护,只读取不删除
+void go_stats::print_goroutines()
+{
+	int fd = bpf_map__fd(skel_->maps.go_goroutines_map);
+	int key, next_key;
+	int *prev_key = NULL;
+	while (!bpf_map_get_next_key(fd, prev_key, &next_key)) {
+		key = next_key;
+		prev_key = &key;
+
+		int64_t count;
+		if (bpf_map_lookup_elem(fd, &key, &count))
+			continue;
+		printf("go goroutines tgid=%d count=%ld\n", key, count);
+	}
+}
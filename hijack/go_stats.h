@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_GO_STATS_H
+#define HIJACK_GO_STATS_H
+
+#include "hijack-common/types.h"
+#include "hijack/hijack.skel.h"
+#include <cstdint>
+
+// 定期取出内核中按进程聚合的 Go 运行时统计并打印,包括 GC 间隔、STW 时长、协程等待 P 的时间和协程数量.
+// 只在主线程调用,不加锁.
+class go_stats {
+    public:
+	int start(struct hijack *skel);
+
+	// 距离上次取出超过 CONFIG_GO_STATS_INTERVAL 秒时执行一次
+	void drain();
+
+    private:
+	void drain_hist(struct bpf_map *map, const char *name);
+	void print_goroutines();
+
+	struct hijack *skel_;
+	uint64_t last_drain_ns_;
+};
+
+#endif
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/governor.h"
+#include "hijack/prog_stats.h"
+#include <bpf/bpf.h>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern class prog_stats prog_stats;
+
+// 功能名称和开销计入该功能的 eBPF 程序,顺序与 SAMPLE_FEATURE_* 一致
+static const struct {
+	const char *name;
+	std::vector<std::string> progs;
+} features[] = {
+	{ "sched_switch", { "sched_switch" } },
+	{ "handle_mm_fault", { "handle_mm_fault_exit" } },
+	{ "tcp_probe", { "tcp_probe" } },
+	{ "pthread_lock",
+	  { "pthread_mutex_lock_enter", "pthread_mutex_lock_exit", "pthread_mutex_unlock_enter", "pthread_rwlock_rdlock_enter",
+	    "pthread_rwlock_rdlock_exit", "pthread_rwlock_wrlock_enter", "pthread_rwlock_wrlock_exit", "pthread_rwlock_unlock_enter" } },
+};
+
+static_assert(sizeof(features) / sizeof(features[0]) == SAMPLE_FEATURE_MAX, "features must match SAMPLE_FEATURE_*");
+
+int governor::start(struct hijack *skel)
+{
+	skel_ = skel;
+	for (int feature = 0; feature < SAMPLE_FEATURE_MAX; ++feature) {
+		sample_rate_[feature] = 1;
+	}
+
+	// 与 prog_stats 采样周期一致,每个周期都能看到上一次调整的效果
+	std::thread adjust_thread([&]() {
+		while (true) {
+			std::this_thread::sleep_for(std::chrono::seconds(CONFIG_PROG_STATS_INTERVAL));
+			adjust();
+		}
+	});
+	adjust_thread.detach();
+	return 0;
+}
+
+void governor::set_enabled(bool enabled)
+{
+	enabled_ = enabled;
+}
+
+void governor::set_budget_ppm(unsigned int budget_ppm)
+{
+	budget_ppm_ = budget_ppm;
+}
+
+void governor::update_sample_rate(int feature, unsigned int rate)
+{
+	sample_rate_[feature] = rate;
+	bpf_map_update_elem(bpf_map__fd(skel_->maps.sample_rate_map), &feature, &rate, BPF_ANY);
+}
+
+void governor::adjust()
+{
+	if (!enabled_) {
+		for (int feature = 0; feature < SAMPLE_FEATURE_MAX; ++feature) {
+			exhausted_[feature] = false;
+			if (sample_rate_[feature] == 1)
+				continue;
+			printf("governor: feature=%s disabled rate=%u->1\n", features[feature].name, sample_rate_[feature]);
+			update_sample_rate(feature, 1);
+		}
+		return;
+	}
+
+	std::map<std::string, unsigned long long> share;
+	for (auto const &stat : prog_stats.snapshot()) {
+		share[stat.name] = stat.cpu_share_ppm;
+	}
+
+	const unsigned int budget = budget_ppm_;
+	for (int feature = 0; feature < SAMPLE_FEATURE_MAX; ++feature) {
+		unsigned long long used = 0;
+		for (auto const &prog : features[feature].progs) {
+			used += share[prog];
+		}
+
+		unsigned int rate = sample_rate_[feature];
+		if (used <= budget)
+			exhausted_[feature] = false;
+
+		if (used > budget && rate < CONFIG_GOVERNOR_SAMPLE_RATE_MAX) {
+			printf("governor: feature=%s share=%lluppm budget=%uppm rate=%u->%u\n", features[feature].name, used, budget, rate, rate * 2);
+			update_sample_rate(feature, rate * 2);
+			continue;
+		}
+
+		// 采样只能减少判断之后的开销,已经降到最低采样率时仍然超出预算,说明程序触发本身的开销已经超出预算
+		if (used > budget) {
+			if (!exhausted_[feature])
+				printf("governor: feature=%s share=%lluppm budget=%uppm rate=%u exhausted\n", features[feature].name, used, budget, rate);
+			exhausted_[feature] = true;
+			continue;
+		}
+
+		// 低于预算一半时才恢复,避免在预算附近来回调整
+		if (used < budget / 2 && rate > 1) {
+			printf("governor: feature=%s share=%lluppm budget=%uppm rate=%u->%u\n", features[feature].name, used, budget, rate, rate / 2);
+			update_sample_rate(feature, rate / 2);
+		}
+	}
+}
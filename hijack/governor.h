@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_GOVERNOR_H
+#define HIJACK_GOVERNOR_H
+
+#include "hijack-common/types.h"
+#include "hijack/hijack.skel.h"
+#include <atomic>
+
+// 根据 prog_stats 的采样结果自动调整各功能的采样率.
+// 功能开销超过预算时采样率翻倍,低于预算的一半时减半,直到恢复为全部处理.
+// 默认关闭,通过 CTL_EVENT_GOVERNOR 开启, 聚合结果在内核中按采样率放大.
+class governor {
+    public:
+	int start(struct hijack *skel);
+
+	// 控制线程调用,关闭时所有功能恢复为全部处理
+	void set_enabled(bool enabled);
+	void set_budget_ppm(unsigned int budget_ppm);
+
+    private:
+	void adjust();
+	void update_sample_rate(int feature, unsigned int rate);
+
+	struct hijack *skel_;
+	std::atomic<bool> enabled_ = false;
+	std::atomic<unsigned int> budget_ppm_ = CONFIG_GOVERNOR_BUDGET_PPM;
+	unsigned int sample_rate_[SAMPLE_FEATURE_MAX] = {};
+	// 已经打印过预算耗尽的功能,恢复到预算以内之前不再重复打印
+	bool exhausted_[SAMPLE_FEATURE_MAX] = {};
+};
+
+#endif
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/kallsyms.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+int kallsyms::load()
+{
+	std::ifstream infile("/proc/kallsyms");
+	std::string line;
+
+	symbols_.clear();
+	while (std::getline(infile, line)) {
+		std::istringstream iss(line);
+		std::string addr, type, name;
+		if (!(iss >> addr >> type >> name))
+			continue;
+
+		// 只保留代码段中的符号
+		if (type != "t" && type != "T" && type != "w" && type != "W")
+			continue;
+
+		uint64_t value = std::stoull(addr, nullptr, 16);
+		if (!value)
+			continue;
+		symbols_.push_back({value, name});
+	}
+
+	std::sort(symbols_.begin(), symbols_.end(), [](const struct symbol &a, const struct symbol &b) { return a.addr < b.addr; });
+	return symbols_.empty() ? -1 : 0;
+}
+
+std::string kallsyms::lookup(uint64_t addr)
+{
+	auto it = std::upper_bound(symbols_.begin(), symbols_.end(), addr, [](uint64_t addr, const struct symbol &sym) { return addr < sym.addr; });
+	if (it == symbols_.begin())
+		return "";
+	return std::prev(it)->name;
+}
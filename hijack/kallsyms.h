@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_KALLSYMS_H
+#define HIJACK_KALLSYMS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 从 /proc/kallsyms 加载内核符号,按地址排序后二分查找.
+// 没有 CAP_SYSLOG 权限时地址全部为 0, 此时所有查找都失败.
+class kallsyms {
+    public:
+	int load();
+
+	// 返回地址所在的函数名,找不到时返回空字符串
+	std::string lookup(uint64_t addr);
+
+    private:
+	struct symbol {
+		uint64_t addr;
+		std::string name;
+	};
+
+	std::vector<struct symbol> symbols_;
+};
+
+#endif
@@ -1,10 +1,20 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "hijack-common/config.h"
 #include "hijack/process.h"
+#include "hijack/profile.h"
 #include "hijack/utils.h"
 #include "hijack/callback.h"
 #include "hijack/control.h"
+#include "hijack/go_stats.h"
+#include "hijack/governor.h"
+#include "hijack/metrics.h"
+#include "hijack/prog_stats.h"
+#include "hijack/python.h"
+#include "hijack/sched_stats.h"
+#include "hijack/stack.h"
+#include "hijack/stack_drainer.h"
 #include "hijack/hijack.skel.h"
+#include <bpf/libbpf_version.h>
 #include <csignal>
 #include <cstdio>
 #include <fcntl.h>
@@ -13,6 +23,15 @@
 struct hijack *skel = NULL;
 class process_collector process_collector;
 class control control;
+class metrics metrics;
+class prog_stats prog_stats;
+class governor governor;
+class stack_drainer stack_drainer;
+class stack_store stack_store;
+class profile_collector profile_collector;
+class sched_stats sched_stats;
+class go_stats go_stats;
+class python_unwinder python_unwinder;
 struct ring_buffer *rb = NULL;
 
 static void handle_signal(int sig)
@@ -56,6 +75,16 @@ static void detach_probes()
 	hijack__detach(skel);
 }
 
+// 在 poll 之前记录 Ringbuf 的积压量,即处理上一批事件期间内核新产生的数据.
+// ring__avail_data_size 和 ring__size 需要 libbpf 1.3 及以上版本,低版本不记录
+static void observe_ring_buffer()
+{
+#if LIBBPF_MAJOR_VERSION > 1 || (LIBBPF_MAJOR_VERSION == 1 && LIBBPF_MINOR_VERSION >= 3)
+	struct ring *ring = ring_buffer__ring(rb, 0);
+	metrics.observe_ring_buffer(ring__avail_data_size(ring), ring__size(ring));
+#endif
+}
+
 static void consume()
 {
 	int error;
@@ -63,12 +92,34 @@ static void consume()
 
 	error = control.start();
 	assert(!error);
+	error = prog_stats.start(skel);
+	assert(!error);
+	error = governor.start(skel);
+	assert(!error);
+	error = stack_drainer.start(skel);
+	assert(!error);
+	error = profile_collector.start(skel);
+	assert(!error);
+	error = sched_stats.start(skel);
+	assert(!error);
+	error = go_stats.start(skel);
+	assert(!error);
 	rb = ring_buffer__new(bpf_map__fd(skel->maps.ringbuf), ring_buffer_callback, NULL, NULL);
 	assert(rb);
 	process_collector.scan_procfs();
 
 	do {
+		observe_ring_buffer();
 		consumed = ring_buffer__poll(rb, 100);
+		// 紧跟在 poll 之后,已经产生的事件大多已被处理,减少 stackid 被重新分配后查到错误调用栈的可能.
+		// 聚合结果引用的 stackid 在同一次循环中先取出,再清理 stack_trace_map
+		if (stack_drainer.due()) {
+			profile_collector.collect();
+			stack_drainer.drain(profile_collector.pinned_stackids());
+		}
+		profile_collector.drain();
+		sched_stats.drain();
+		go_stats.drain();
 	} while (consumed >= 0);
 
 	ring_buffer__free(rb);
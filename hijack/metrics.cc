@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/metrics.h"
+#include <cstring>
+#include <ctime>
+
+static_assert(RB_EVENT_MAX <= CONFIG_METRICS_EVENT_TYPE_MAX, "CONFIG_METRICS_EVENT_TYPE_MAX too small");
+static_assert(sizeof(struct ctl_metrics) <= CONFIG_CTL_BUFFER_SIZE_MAX, "CONFIG_CTL_BUFFER_SIZE_MAX too small");
+
+static const long NS_PER_SEC = 1000000000L;
+
+uint64_t boottime_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_BOOTTIME, &now);
+	return now.tv_sec * NS_PER_SEC + now.tv_nsec;
+}
+
+void histogram::observe(uint64_t ns)
+{
+	int slot = ns ? 63 - __builtin_clzll(ns) : 0;
+	if (slot >= CONFIG_METRICS_HIST_SLOTS)
+		slot = CONFIG_METRICS_HIST_SLOTS - 1;
+
+	slots_[slot].fetch_add(1, std::memory_order_relaxed);
+}
+
+void histogram::snapshot(void *slots)
+{
+	unsigned long long tmp[CONFIG_METRICS_HIST_SLOTS];
+	for (int idx = 0; idx < CONFIG_METRICS_HIST_SLOTS; ++idx) {
+		tmp[idx] = slots_[idx].load(std::memory_order_relaxed);
+	}
+	memcpy(slots, tmp, sizeof(tmp));
+}
+
+void metrics::observe_event(unsigned int type, uint64_t ns)
+{
+	if (type >= CONFIG_METRICS_EVENT_TYPE_MAX)
+		return;
+
+	event_count_[type].fetch_add(1, std::memory_order_relaxed);
+	event_handle_ns_[type].fetch_add(ns, std::memory_order_relaxed);
+	event_handle_hist_[type].observe(ns);
+}
+
+void metrics::observe_delay(unsigned long long nsec, uint64_t now)
+{
+	// 时间戳来自同一个时钟源,理论上不会出现负数,这里只是防御
+	event_delay_hist_.observe(now > nsec ? now - nsec : 0);
+}
+
+void metrics::observe_symbolize(uint64_t ns)
+{
+	symbolize_hist_.observe(ns);
+}
+
+void metrics::observe_control(uint64_t ns)
+{
+	control_hist_.observe(ns);
+}
+
+void metrics::observe_ring_buffer(size_t avail, size_t size)
+{
+	ringbuf_size_.store(size, std::memory_order_relaxed);
+	ringbuf_avail_.store(avail, std::memory_order_relaxed);
+	if (avail > ringbuf_avail_max_.load(std::memory_order_relaxed)) {
+		ringbuf_avail_max_.store(avail, std::memory_order_relaxed);
+	}
+}
+
+void metrics::observe_stack_drain(uint64_t drained, uint64_t store_size)
+{
+	stack_drained_.fetch_add(drained, std::memory_order_relaxed);
+	stack_store_size_.store(store_size, std::memory_order_relaxed);
+}
+
+void metrics::observe_stack_collision()
+{
+	stack_collisions_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void metrics::observe_stack_eviction()
+{
+	stack_evictions_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void metrics::observe_stackid_errors(uint64_t collisions, uint64_t errors)
+{
+	stackid_collisions_.store(collisions, std::memory_order_relaxed);
+	stackid_errors_.store(errors, std::memory_order_relaxed);
+}
+
+void metrics::snapshot(struct ctl_metrics *ctl)
+{
+	ctl->nsec = boottime_ns();
+
+	for (int type = 0; type < CONFIG_METRICS_EVENT_TYPE_MAX; ++type) {
+		ctl->event_count[type] = event_count_[type].load(std::memory_order_relaxed);
+		ctl->event_handle_ns[type] = event_handle_ns_[type].load(std::memory_order_relaxed);
+		event_handle_hist_[type].snapshot(ctl->event_handle_hist[type]);
+	}
+
+	event_delay_hist_.snapshot(ctl->event_delay_hist);
+	symbolize_hist_.snapshot(ctl->symbolize_hist);
+	control_hist_.snapshot(ctl->control_hist);
+
+	ctl->ringbuf_size = ringbuf_size_.load(std::memory_order_relaxed);
+	ctl->ringbuf_avail = ringbuf_avail_.load(std::memory_order_relaxed);
+	ctl->ringbuf_avail_max = ringbuf_avail_max_.load(std::memory_order_relaxed);
+
+	ctl->stack_drained = stack_drained_.load(std::memory_order_relaxed);
+	ctl->stack_collisions = stack_collisions_.load(std::memory_order_relaxed);
+	ctl->stack_evictions = stack_evictions_.load(std::memory_order_relaxed);
+	ctl->stack_store_size = stack_store_size_.load(std::memory_order_relaxed);
+	ctl->stackid_collisions = stackid_collisions_.load(std::memory_order_relaxed);
+	ctl->stackid_errors = stackid_errors_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_METRICS_H
+#define HIJACK_METRICS_H
+
+#include "hijack-common/types.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 以 2 为底取对数分桶的直方图,只做原子自增,可以在热路径上常驻.
+class histogram {
+    public:
+	void observe(uint64_t ns);
+	// ctl_metrics 是紧凑结构体,成员可能不对齐,统一通过 memcpy 写入
+	void snapshot(void *slots);
+
+    private:
+	std::atomic<uint64_t> slots_[CONFIG_METRICS_HIST_SLOTS] = {};
+};
+
+// hijack 自身的运行指标.事件处理在主线程,查询在控制线程,所有字段都是原子变量,不加锁.
+class metrics {
+    public:
+	// 单个事件的处理耗时,在 ring_buffer_callback 中统计
+	void observe_event(unsigned int type, uint64_t ns);
+
+	// 内核产生事件的时间戳 nsec 与用户态开始处理的时间 now 之差
+	void observe_delay(unsigned long long nsec, uint64_t now);
+
+	// 单个调用栈的符号化耗时
+	void observe_symbolize(uint64_t ns);
+
+	// 单个控制请求的处理耗时
+	void observe_control(uint64_t ns);
+
+	// 每次 poll 前记录 Ringbuf 中尚未消费的数据量,即处理上一批事件期间内核新产生的数据. 需要 libbpf 1.3 及以上版本
+	void observe_ring_buffer(size_t avail, size_t size);
+
+	// stack_trace_map 单次清理的数量和清理后用户态保存的调用栈数量
+	void observe_stack_drain(uint64_t drained, uint64_t store_size);
+
+	// 用户态保存的 stackid 被内核分配给了其他调用栈
+	void observe_stack_collision();
+
+	// 用户态保存的调用栈超过上限被淘汰
+	void observe_stack_eviction();
+
+	// 内核中 bpf_get_stackid 失败的累计次数
+	void observe_stackid_errors(uint64_t collisions, uint64_t errors);
+
+	// 填充控制请求的响应
+	void snapshot(struct ctl_metrics *ctl);
+
+    private:
+	std::atomic<uint64_t> event_count_[CONFIG_METRICS_EVENT_TYPE_MAX] = {};
+	std::atomic<uint64_t> event_handle_ns_[CONFIG_METRICS_EVENT_TYPE_MAX] = {};
+	class histogram event_handle_hist_[CONFIG_METRICS_EVENT_TYPE_MAX];
+	class histogram event_delay_hist_;
+	class histogram symbolize_hist_;
+	class histogram control_hist_;
+	std::atomic<uint64_t> ringbuf_size_ = 0;
+	std::atomic<uint64_t> ringbuf_avail_ = 0;
+	std::atomic<uint64_t> ringbuf_avail_max_ = 0;
+	std::atomic<uint64_t> stack_drained_ = 0;
+	std::atomic<uint64_t> stack_collisions_ = 0;
+	std::atomic<uint64_t> stack_evictions_ = 0;
+	std::atomic<uint64_t> stack_store_size_ = 0;
+	std::atomic<uint64_t> stackid_collisions_ = 0;
+	std::atomic<uint64_t> stackid_errors_ = 0;
+};
+
+// 与 bpf_ktime_get_boot_ns 同一时钟源的纳秒时间戳
+uint64_t boottime_ns();
+
+#endif
@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/pprof.h"
+#include <zlib.h>
+
+// protobuf 的线格式,只用到 varint 和 length-delimited 两种类型
+enum {
+	WIRE_VARINT = 0,
+	WIRE_BYTES = 2,
+};
+
+static void encode_varint(std::string &buf, uint64_t value)
+{
+	while (value >= 0x80) {
+		buf.push_back((char)(value | 0x80));
+		value >>= 7;
+	}
+	buf.push_back((char)value);
+}
+
+static void encode_tag(std::string &buf, int field, int wire)
+{
+	encode_varint(buf, ((uint64_t)field << 3) | wire);
+}
+
+// 值为 0 时按 proto3 的约定省略
+static void encode_uint64(std::string &buf, int field, uint64_t value)
+{
+	if (!value)
+		return;
+	encode_tag(buf, field, WIRE_VARINT);
+	encode_varint(buf, value);
+}
+
+static void encode_bytes(std::string &buf, int field, const std::string &value)
+{
+	encode_tag(buf, field, WIRE_BYTES);
+	encode_varint(buf, value.size());
+	buf += value;
+}
+
+// repeated 数值字段使用 packed 编码
+template <typename T> static void encode_packed(std::string &buf, int field, const std::vector<T> &values)
+{
+	if (values.empty())
+		return;
+
+	std::string packed;
+	for (T value : values) {
+		encode_varint(packed, (uint64_t)value);
+	}
+	encode_bytes(buf, field, packed);
+}
+
+pprof_profile::pprof_profile(const std::vector<std::pair<std::string, std::string>> &sample_types, int64_t time_nanos, int64_t duration_nanos)
+    : time_nanos_(time_nanos), duration_nanos_(duration_nanos)
+{
+	// 字符串表的第一个元素必须是空字符串
+	intern_string("");
+	for (auto &[type, unit] : sample_types) {
+		// 参数的求值顺序不确定,分开写保证字符串表的顺序稳定
+		int64_t type_idx = intern_string(type);
+		int64_t unit_idx = intern_string(unit);
+		sample_types_.emplace_back(type_idx, unit_idx);
+	}
+}
+
+uint64_t pprof_profile::add_mapping(uint64_t start, uint64_t limit, uint64_t offset, const std::string &filename)
+{
+	mappings_.push_back({start, limit, offset, intern_string(filename)});
+	return mappings_.size();
+}
+
+uint64_t pprof_profile::add_location(uint64_t mapping_id, uint64_t address, const std::string &function, const std::string &filename, int64_t line)
+{
+	uint64_t id = find_location(mapping_id, address);
+	if (id)
+		return id;
+
+	locations_.push_back({mapping_id, address, intern_function(function, filename), line});
+	id = locations_.size();
+	location_index_[{mapping_id, address}] = id;
+	return id;
+}
+
+uint64_t pprof_profile::find_location(uint64_t mapping_id, uint64_t address)
+{
+	auto it = location_index_.find({mapping_id, address});
+	return it == location_index_.end() ? 0 : it->second;
+}
+
+void pprof_profile::add_sample(const std::vector<uint64_t> &locations, const std::vector<int64_t> &values)
+{
+	std::vector<int64_t> &sum = samples_[locations];
+	sum.resize(sample_types_.size());
+	for (size_t idx = 0; idx < values.size() && idx < sum.size(); ++idx) {
+		sum[idx] += values[idx];
+	}
+}
+
+std::string pprof_profile::encode()
+{
+	std::string buf;
+
+	for (auto &[type, unit] : sample_types_) {
+		std::string value_type;
+		encode_uint64(value_type, 1, type);
+		encode_uint64(value_type, 2, unit);
+		encode_bytes(buf, 1, value_type);
+	}
+
+	for (auto &[locations, values] : samples_) {
+		std::string sample;
+		encode_packed(sample, 1, locations);
+		encode_packed(sample, 2, values);
+		encode_bytes(buf, 2, sample);
+	}
+
+	for (size_t idx = 0; idx < mappings_.size(); ++idx) {
+		std::string mapping;
+		encode_uint64(mapping, 1, idx + 1);
+		encode_uint64(mapping, 2, mappings_[idx].start);
+		encode_uint64(mapping, 3, mappings_[idx].limit);
+		encode_uint64(mapping, 4, mappings_[idx].offset);
+		encode_uint64(mapping, 5, mappings_[idx].filename);
+		encode_bytes(buf, 3, mapping);
+	}
+
+	for (size_t idx = 0; idx < locations_.size(); ++idx) {
+		std::string line;
+		encode_uint64(line, 1, locations_[idx].function_id);
+		encode_uint64(line, 2, locations_[idx].line);
+
+		std::string location;
+		encode_uint64(location, 1, idx + 1);
+		encode_uint64(location, 2, locations_[idx].mapping_id);
+		encode_uint64(location, 3, locations_[idx].address);
+		encode_bytes(location, 4, line);
+		encode_bytes(buf, 4, location);
+	}
+
+	for (size_t idx = 0; idx < functions_.size(); ++idx) {
+		std::string function;
+		encode_uint64(function, 1, idx + 1);
+		encode_uint64(function, 2, functions_[idx].name);
+		encode_uint64(function, 3, functions_[idx].name);
+		encode_uint64(function, 4, functions_[idx].filename);
+		encode_bytes(buf, 5, function);
+	}
+
+	for (const std::string &str : strings_) {
+		encode_bytes(buf, 6, str);
+	}
+
+	encode_uint64(buf, 9, time_nanos_);
+	encode_uint64(buf, 10, duration_nanos_);
+	return buf;
+}
+
+int64_t pprof_profile::intern_string(const std::string &str)
+{
+	auto it = string_index_.find(str);
+	if (it != string_index_.end())
+		return it->second;
+
+	int64_t idx = strings_.size();
+	strings_.push_back(str);
+	string_index_[str] = idx;
+	return idx;
+}
+
+uint64_t pprof_profile::intern_function(const std::string &name, const std::string &filename)
+{
+	int64_t name_idx = intern_string(name);
+	int64_t filename_idx = intern_string(filename);
+	std::pair<int64_t, int64_t> key = {name_idx, filename_idx};
+	auto it = function_index_.find(key);
+	if (it != function_index_.end())
+		return it->second;
+
+	functions_.push_back({key.first, key.second});
+	function_index_[key] = functions_.size();
+	return functions_.size();
+}
+
+int gzip_compress(const std::string &in, std::string &out)
+{
+	z_stream stream = {};
+
+	// windowBits 加 16 表示输出 gzip 格式
+	int ret = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY);
+	if (ret != Z_OK)
+		return ret;
+
+	out.resize(deflateBound(&stream, in.size()));
+	stream.next_in = (Bytef *)in.data();
+	stream.avail_in = in.size();
+	stream.next_out = (Bytef *)out.data();
+	stream.avail_out = out.size();
+
+	ret = deflate(&stream, Z_FINISH);
+	out.resize(stream.total_out);
+	deflateEnd(&stream);
+	return ret == Z_STREAM_END ? 0 : -1;
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_PPROF_H
+#define HIJACK_PPROF_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 按 https://github.com/google/pprof/blob/main/proto/profile.proto 手工编码的 pprof 格式.
+// 字符串、映射、函数、地址和调用栈都会去重,相同调用栈的样本数值直接累加.
+class pprof_profile {
+    public:
+	// sample_types 为每一列样本数值的 (类型, 单位), 例如 ("offcpu", "nanoseconds")
+	pprof_profile(const std::vector<std::pair<std::string, std::string>> &sample_types, int64_t time_nanos, int64_t duration_nanos);
+
+	uint64_t add_mapping(uint64_t start, uint64_t limit, uint64_t offset, const std::string &filename);
+
+	// 同一个映射中的同一个地址只会创建一次, mapping_id 为 0 表示不属于任何映射
+	uint64_t add_location(uint64_t mapping_id, uint64_t address, const std::string &function, const std::string &filename, int64_t line);
+
+	// 查找已经创建的地址,不存在时返回 0
+	uint64_t find_location(uint64_t mapping_id, uint64_t address);
+
+	// locations 从栈顶开始, values 的长度与 sample_types 一致
+	void add_sample(const std::vector<uint64_t> &locations, const std::vector<int64_t> &values);
+
+	// 序列化为未压缩的 protobuf
+	std::string encode();
+
+    private:
+	struct mapping {
+		uint64_t start;
+		uint64_t limit;
+		uint64_t offset;
+		int64_t filename;
+	};
+
+	struct location {
+		uint64_t mapping_id;
+		uint64_t address;
+		uint64_t function_id;
+		int64_t line;
+	};
+
+	struct function {
+		int64_t name;
+		int64_t filename;
+	};
+
+	int64_t intern_string(const std::string &str);
+	uint64_t intern_function(const std::string &name, const std::string &filename);
+
+	std::vector<std::pair<int64_t, int64_t>> sample_types_;
+	int64_t time_nanos_;
+	int64_t duration_nanos_;
+
+	std::vector<std::string> strings_;
+	std::unordered_map<std::string, int64_t> string_index_;
+	std::vector<struct mapping> mappings_;
+	std::vector<struct function> functions_;
+	std::map<std::pair<int64_t, int64_t>, uint64_t> function_index_;
+	std::vector<struct location> locations_;
+	std::map<std::pair<uint64_t, uint64_t>, uint64_t> location_index_;
+	std::map<std::vector<uint64_t>, std::vector<int64_t>> samples_;
+};
+
+// 以 gzip 格式压缩, pprof 工具只接受 gzip 压缩或者未压缩的数据
+int gzip_compress(const std::string &in, std::string &out);
+
+#endif
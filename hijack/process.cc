@@ -2,10 +2,16 @@
 #include "hijack/process.h"
 #include "hijack/binary.h"
 #include <bpf/libbpf.h>
+#include <cerrno>
 #include <cstdio>
 #include <dirent.h>
+#include <fcntl.h>
 #include <filesystem>
+#include <fstream>
 #include <set>
+#include <sstream>
+#include <unistd.h>
+#include <vector>
 
 extern class process_collector process_collector;
 
@@ -141,6 +147,82 @@ int process_collector::unhook_default_probe(pid_t pid, struct hijack *skel)
 	return 0;
 }
 
+int process_collector::hook_lock_probe(pid_t pid, struct hijack *skel)
+{
+	auto &process = process_map[pid];
+	process.hook_pthread_lock_function(skel);
+	return 0;
+}
+
+int process_collector::unhook_lock_probe(pid_t pid, struct hijack *skel)
+{
+	auto &process = process_map[pid];
+	process.unhook_pthread_lock_function(skel);
+	return 0;
+}
+
+int process_collector::hook_go_offcpu_probe(pid_t pid, struct hijack *skel)
+{
+	auto &process = process_map[pid];
+	process.hook_golang_park_function(skel);
+	return 0;
+}
+
+int process_collector::unhook_go_offcpu_probe(pid_t pid, struct hijack *skel)
+{
+	auto &process = process_map[pid];
+	process.unhook_golang_park_function(skel);
+	return 0;
+}
+
+int process_collector::hook_go_sched_probe(pid_t pid, struct hijack *skel)
+{
+	auto &process = process_map[pid];
+	process.hook_golang_sched_function(skel);
+	return 0;
+}
+
+int process_collector::unhook_go_sched_probe(pid_t pid, struct hijack *skel)
+{
+	auto &process = process_map[pid];
+	process.unhook_golang_sched_function(skel);
+	return 0;
+}
+
+long process_collector::count_go_goroutines(pid_t pid)
+{
+	auto &process = process_map[pid];
+	return process.count_golang_goroutines();
+}
+
+int process_collector::hook_malloc_probe(pid_t pid, struct hijack *skel)
+{
+	auto &process = process_map[pid];
+	process.hook_libc_malloc_function(skel);
+	return 0;
+}
+
+int process_collector::unhook_malloc_probe(pid_t pid, struct hijack *skel)
+{
+	auto &process = process_map[pid];
+	process.unhook_libc_malloc_function(skel);
+	return 0;
+}
+
+int process_collector::hook_go_malloc_probe(pid_t pid, struct hijack *skel)
+{
+	auto &process = process_map[pid];
+	process.hook_golang_malloc_function(skel);
+	return 0;
+}
+
+int process_collector::unhook_go_malloc_probe(pid_t pid, struct hijack *skel)
+{
+	auto &process = process_map[pid];
+	process.unhook_golang_malloc_function(skel);
+	return 0;
+}
+
 int process_item::hook_golang_runtime_function(struct hijack *skel)
 {
 	if (!binary_ctx) {
@@ -165,6 +247,25 @@ int process_item::hook_golang_runtime_function(struct hijack *skel)
 		this->bpf_links["runtime_newproc1_exit"] = link;
 	}
 
+	// GC 和 STW 的频率很低,随进程一起挂载
+	func_offset = binary_sym_to_addr(binary_ctx.get(), "runtime.gcBgMarkStartWorkers");
+	if (func_offset && !this->bpf_links["runtime_gcbgmarkstartworkers_enter"]) {
+		link = bpf_program__attach_uprobe(skel->progs.runtime_gcbgmarkstartworkers_enter, false, pid, binary_path, func_offset);
+		this->bpf_links["runtime_gcbgmarkstartworkers_enter"] = link;
+	}
+
+	func_offset = binary_sym_to_addr(binary_ctx.get(), "runtime.stopTheWorldWithSema");
+	if (func_offset && !this->bpf_links["runtime_stoptheworld_enter"]) {
+		link = bpf_program__attach_uprobe(skel->progs.runtime_stoptheworld_enter, false, pid, binary_path, func_offset);
+		this->bpf_links["runtime_stoptheworld_enter"] = link;
+	}
+
+	func_offset = binary_sym_to_addr(binary_ctx.get(), "runtime.startTheWorldWithSema");
+	if (func_offset && !this->bpf_links["runtime_starttheworld_enter"]) {
+		link = bpf_program__attach_uprobe(skel->progs.runtime_starttheworld_enter, false, pid, binary_path, func_offset);
+		this->bpf_links["runtime_starttheworld_enter"] = link;
+	}
+
 	return 0;
 }
 
@@ -182,6 +283,187 @@ int process_item::unhook_golang_runtime_function(struct hijack *skel)
 		bpf_link__destroy(link);
 	}
 
+	link = this->bpf_links["runtime_gcbgmarkstartworkers_enter"];
+	if (link) {
+		bpf_link__destroy(link);
+	}
+	this->bpf_links.erase("runtime_gcbgmarkstartworkers_enter");
+
+	link = this->bpf_links["runtime_stoptheworld_enter"];
+	if (link) {
+		bpf_link__destroy(link);
+	}
+	this->bpf_links.erase("runtime_stoptheworld_enter");
+
+	link = this->bpf_links["runtime_starttheworld_enter"];
+	if (link) {
+		bpf_link__destroy(link);
+	}
+	this->bpf_links.erase("runtime_starttheworld_enter");
+
+	return 0;
+}
+
+int process_item::hook_golang_park_function(struct hijack *skel)
+{
+	if (!binary_ctx) {
+		return 0;
+	}
+
+	const pid_t pid = this->pid;
+	const char *binary_path = binary_ctx->abfd->filename;
+	struct bpf_link *link;
+	unsigned long long func_offset = 0;
+
+	func_offset = binary_sym_to_addr(binary_ctx.get(), "runtime.gopark");
+	if (func_offset && !this->bpf_links["runtime_gopark_enter"]) {
+		link = bpf_program__attach_uprobe(skel->progs.runtime_gopark_enter, false, pid, binary_path, func_offset);
+		this->bpf_links["runtime_gopark_enter"] = link;
+	}
+
+	func_offset = binary_sym_to_addr(binary_ctx.get(), "runtime.casgstatus");
+	if (func_offset && !this->bpf_links["runtime_casgstatus_enter"]) {
+		link = bpf_program__attach_uprobe(skel->progs.runtime_casgstatus_enter, false, pid, binary_path, func_offset);
+		this->bpf_links["runtime_casgstatus_enter"] = link;
+	}
+
+	return 0;
+}
+
+int process_item::unhook_golang_park_function(struct hijack *skel)
+{
+	struct bpf_link *link;
+
+	link = this->bpf_links["runtime_gopark_enter"];
+	if (link) {
+		bpf_link__destroy(link);
+	}
+	this->bpf_links.erase("runtime_gopark_enter");
+
+	link = this->bpf_links["runtime_casgstatus_enter"];
+	if (link) {
+		bpf_link__destroy(link);
+	}
+	this->bpf_links.erase("runtime_casgstatus_enter");
+
+	return 0;
+}
+
+int process_item::hook_golang_malloc_function(struct hijack *skel)
+{
+	if (!binary_ctx) {
+		return 0;
+	}
+
+	const pid_t pid = this->pid;
+	const char *binary_path = binary_ctx->abfd->filename;
+	struct bpf_link *link;
+	unsigned long long func_offset = 0;
+
+	func_offset = binary_sym_to_addr(binary_ctx.get(), "runtime.mallocgc");
+	if (func_offset && !this->bpf_links["runtime_mallocgc_enter"]) {
+		link = bpf_program__attach_uprobe(skel->progs.runtime_mallocgc_enter, false, pid, binary_path, func_offset);
+		this->bpf_links["runtime_mallocgc_enter"] = link;
+	}
+
+	return 0;
+}
+
+int process_item::unhook_golang_malloc_function(struct hijack *skel)
+{
+	struct bpf_link *link;
+
+	link = this->bpf_links["runtime_mallocgc_enter"];
+	if (link) {
+		bpf_link__destroy(link);
+	}
+	this->bpf_links.erase("runtime_mallocgc_enter");
+
+	return 0;
+}
+
+static const struct {
+	const char *symbol;
+	const char *prog;
+} golang_sched_probes[] = {
+	{ "runtime.runqput", "runtime_runqput_enter" },
+	{ "runtime.execute", "runtime_execute_enter" },
+	{ "runtime.goexit1", "runtime_goexit1_enter" },
+};
+
+int process_item::hook_golang_sched_function(struct hijack *skel)
+{
+	if (!binary_ctx) {
+		return 0;
+	}
+
+	const pid_t pid = this->pid;
+	const char *binary_path = binary_ctx->abfd->filename;
+
+	for (auto const &probe : golang_sched_probes) {
+		unsigned long long func_offset = binary_sym_to_addr(binary_ctx.get(), probe.symbol);
+		if (!func_offset || this->bpf_links[probe.prog])
+			continue;
+
+		struct bpf_program *prog = bpf_object__find_program_by_name(skel->obj, probe.prog);
+		this->bpf_links[probe.prog] = bpf_program__attach_uprobe(prog, false, pid, binary_path, func_offset);
+	}
+
+	return 0;
+}
+
+// g 结构体中 atomicstatus 的偏移,与 eBPF 中 goid 的偏移(152)对应同一套 Go 版本的布局
+static const unsigned long GO_G_ATOMICSTATUS_OFFSET = 144;
+static const unsigned int GO_G_DEAD = 6;
+
+long process_item::count_golang_goroutines()
+{
+	if (!binary_ctx) {
+		return -1;
+	}
+
+	unsigned long allgs_addr = binary_sym_to_addr(binary_ctx.get(), "runtime.allgs");
+	if (!allgs_addr) {
+		return -1;
+	}
+	allgs_addr += binary_ctx->addr_start;
+
+	int fd = open(("/proc/" + std::to_string(pid) + "/mem").data(), O_RDONLY);
+	if (fd < 0) {
+		return -1;
+	}
+
+	// allgs 是 []*g, 退出的协程放回空闲列表复用,不会从 allgs 中删除.
+	// 读取时运行时可能在扩容,只读取一次切片头,结果是近似值
+	long count = -1;
+	unsigned long slice[3];
+	if (pread(fd, slice, sizeof(slice), allgs_addr) == sizeof(slice) && slice[1] <= slice[2]) {
+		std::vector<unsigned long> gs(slice[1]);
+		ssize_t size = gs.size() * sizeof(gs[0]);
+		if (pread(fd, gs.data(), size, slice[0]) == size) {
+			count = 0;
+			for (unsigned long g : gs) {
+				unsigned int status;
+				if (pread(fd, &status, sizeof(status), g + GO_G_ATOMICSTATUS_OFFSET) == sizeof(status) && status != GO_G_DEAD)
+					count += 1;
+			}
+		}
+	}
+
+	close(fd);
+	return count;
+}
+
+int process_item::unhook_golang_sched_function(struct hijack *skel)
+{
+	for (auto const &probe : golang_sched_probes) {
+		struct bpf_link *link = this->bpf_links[probe.prog];
+		if (link) {
+			bpf_link__destroy(link);
+		}
+		this->bpf_links.erase(probe.prog);
+	}
+
 	return 0;
 }
 
@@ -338,6 +620,127 @@ int process_item::unhook_golang_http2_grpc_function(struct hijack *skel)
 	return 0;
 }
 
+// 在 /proc/<pid>/maps 中查找文件名以 name 开头的动态库,返回从进程的根目录访问的路径,兼容容器中的进程
+static std::string find_shared_library(pid_t pid, const std::string &name)
+{
+	std::ifstream infile("/proc/" + std::to_string(pid) + "/maps");
+	std::string line;
+
+	while (std::getline(infile, line)) {
+		std::string range, perms, offset, dev, inode, path;
+		std::istringstream iss(line);
+		if (!(iss >> range >> perms >> offset >> dev >> inode >> path))
+			continue;
+
+		if (std::filesystem::path(path).filename().string().starts_with(name))
+			return "/proc/" + std::to_string(pid) + "/root" + path;
+	}
+	return "";
+}
+
+// 通过函数名挂载到动态库上的探针,偏移由 libbpf 解析
+struct library_probe {
+	const char *func;
+	bool retprobe;
+	const char *prog;
+};
+
+static const struct library_probe pthread_lock_probes[] = {
+	{ "pthread_mutex_lock", false, "pthread_mutex_lock_enter" },
+	{ "pthread_mutex_lock", true, "pthread_mutex_lock_exit" },
+	{ "pthread_mutex_unlock", false, "pthread_mutex_unlock_enter" },
+	{ "pthread_rwlock_rdlock", false, "pthread_rwlock_rdlock_enter" },
+	{ "pthread_rwlock_rdlock", true, "pthread_rwlock_rdlock_exit" },
+	{ "pthread_rwlock_wrlock", false, "pthread_rwlock_wrlock_enter" },
+	{ "pthread_rwlock_wrlock", true, "pthread_rwlock_wrlock_exit" },
+	{ "pthread_rwlock_unlock", false, "pthread_rwlock_unlock_enter" },
+	{ "pthread_cond_wait", false, "pthread_cond_wait_enter" },
+	{ "pthread_cond_wait", true, "pthread_cond_wait_exit" },
+	{ "pthread_cond_timedwait", false, "pthread_cond_timedwait_enter" },
+	{ "pthread_cond_timedwait", true, "pthread_cond_timedwait_exit" },
+};
+
+static const struct library_probe libc_malloc_probes[] = {
+	{ "malloc", false, "malloc_enter" },
+	{ "malloc", true, "malloc_exit" },
+	{ "calloc", false, "calloc_enter" },
+	{ "calloc", true, "calloc_exit" },
+	{ "realloc", false, "realloc_enter" },
+	{ "realloc", true, "realloc_exit" },
+	{ "free", false, "free_enter" },
+};
+
+// binary_path 中找不到函数时再尝试 fallback_path
+template <size_t N>
+static void attach_library_probes(struct process_item *item, struct hijack *skel, const std::string &binary_path, const struct library_probe (&probes)[N],
+				  const std::string &fallback_path = "")
+{
+	for (auto const &probe : probes) {
+		if (item->bpf_links[probe.prog])
+			continue;
+
+		LIBBPF_OPTS(bpf_uprobe_opts, opts, .retprobe = probe.retprobe, .func_name = probe.func);
+		struct bpf_program *prog = bpf_object__find_program_by_name(skel->obj, probe.prog);
+		struct bpf_link *link = bpf_program__attach_uprobe_opts(prog, item->pid, binary_path.data(), 0, &opts);
+		if (!link && !fallback_path.empty() && fallback_path != binary_path)
+			link = bpf_program__attach_uprobe_opts(prog, item->pid, fallback_path.data(), 0, &opts);
+		if (!link) {
+			printf("attach %s to %s failed: pid=%d errno=%d\n", probe.func, binary_path.data(), item->pid, errno);
+			continue;
+		}
+		item->bpf_links[probe.prog] = link;
+	}
+}
+
+template <size_t N> static void detach_library_probes(struct process_item *item, const struct library_probe (&probes)[N])
+{
+	for (auto const &probe : probes) {
+		struct bpf_link *link = item->bpf_links[probe.prog];
+		if (link) {
+			bpf_link__destroy(link);
+		}
+		item->bpf_links.erase(probe.prog);
+	}
+}
+
+// 动态链接时使用 libc, 静态链接时在可执行文件中
+static std::string libc_path(pid_t pid)
+{
+	std::string binary_path = find_shared_library(pid, "libc.so");
+	if (binary_path.empty())
+		binary_path = "/proc/" + std::to_string(pid) + "/exe";
+	return binary_path;
+}
+
+int process_item::hook_pthread_lock_function(struct hijack *skel)
+{
+	// glibc 2.34 之前 pthread 锁在 libpthread 中,之后合并到 libc 中, libpthread 只是保留的空壳, 每个函数都可以回退到 libc
+	std::string binary_path = find_shared_library(pid, "libpthread.so");
+	if (binary_path.empty())
+		binary_path = libc_path(pid);
+
+	attach_library_probes(this, skel, binary_path, pthread_lock_probes, libc_path(pid));
+	return 0;
+}
+
+int process_item::unhook_pthread_lock_function(struct hijack *skel)
+{
+	detach_library_probes(this, pthread_lock_probes);
+	return 0;
+}
+
+int process_item::hook_libc_malloc_function(struct hijack *skel)
+{
+	attach_library_probes(this, skel, libc_path(pid), libc_malloc_probes);
+	return 0;
+}
+
+int process_item::unhook_libc_malloc_function(struct hijack *skel)
+{
+	detach_library_probes(this, libc_malloc_probes);
+	return 0;
+}
+
 #if CONFIG_USDT
 int process_item::hook_hijack_control(struct hijack *skel)
 {
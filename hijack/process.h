@@ -18,6 +18,17 @@ struct process_item {
 	// Go 运行时探针
 	int hook_golang_runtime_function(struct hijack *skel);
 	int unhook_golang_runtime_function(struct hijack *skel);
+	// Go 协程挂起和唤醒探针
+	int hook_golang_park_function(struct hijack *skel);
+	int unhook_golang_park_function(struct hijack *skel);
+	// Go 协程调度探针
+	int hook_golang_sched_function(struct hijack *skel);
+	int unhook_golang_sched_function(struct hijack *skel);
+	// 遍历 runtime.allgs 统计状态不是 _Gdead 的协程数量,失败时返回 -1
+	long count_golang_goroutines();
+	// Go 堆内存分配探针
+	int hook_golang_malloc_function(struct hijack *skel);
+	int unhook_golang_malloc_function(struct hijack *skel);
 	// Go 格式化探针
 	int hook_golang_fmt_function(struct hijack *skel);
 	int unhook_golang_fmt_function(struct hijack *skel);
@@ -29,6 +40,13 @@ struct process_item {
 	int hook_golang_http2_grpc_function(struct hijack *skel);
 	int unhook_golang_http2_grpc_function(struct hijack *skel);
 
+	// libc 中的 pthread 锁探针
+	int hook_pthread_lock_function(struct hijack *skel);
+	int unhook_pthread_lock_function(struct hijack *skel);
+	// libc 中的内存分配探针
+	int hook_libc_malloc_function(struct hijack *skel);
+	int unhook_libc_malloc_function(struct hijack *skel);
+
 	// 当前进程的 USDT
 	int hook_hijack_control(struct hijack *skel);
 	int unhook_hijack_control(struct hijack *skel);
@@ -62,6 +80,28 @@ class process_collector {
 	int hook_default_probe(pid_t pid, struct hijack *skel);
 	int unhook_default_probe(pid_t pid, struct hijack *skel);
 
+	// 开启锁统计时添加的探针,每次加锁解锁都会触发,只在需要时挂载
+	int hook_lock_probe(pid_t pid, struct hijack *skel);
+	int unhook_lock_probe(pid_t pid, struct hijack *skel);
+
+	// 开启协程 offcpu 时添加的探针, runtime.casgstatus 在每次调度时都会触发,只在需要时挂载
+	int hook_go_offcpu_probe(pid_t pid, struct hijack *skel);
+	int unhook_go_offcpu_probe(pid_t pid, struct hijack *skel);
+
+	// 开启协程调度统计时添加的探针,与协程 offcpu 一样只在需要时挂载
+	int hook_go_sched_probe(pid_t pid, struct hijack *skel);
+	int unhook_go_sched_probe(pid_t pid, struct hijack *skel);
+	// 进程当前的协程数量,用于开启时设置初始值
+	long count_go_goroutines(pid_t pid);
+
+	// 开启内存分配统计时添加的探针
+	int hook_malloc_probe(pid_t pid, struct hijack *skel);
+	int unhook_malloc_probe(pid_t pid, struct hijack *skel);
+
+	// 开启 Go 堆内存分配统计时添加的探针, runtime.mallocgc 调用非常频繁,只在需要时挂载
+	int hook_go_malloc_probe(pid_t pid, struct hijack *skel);
+	int unhook_go_malloc_probe(pid_t pid, struct hijack *skel);
+
     private:
 	// 保存系统中的所有进程
 	std::map<pid_t, struct process_item> process_map;
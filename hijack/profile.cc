@@ -0,0 +1,724 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/profile.h"
+#include "hijack/metrics.h"
+#include "hijack/process.h"
+#include "hijack/stack.h"
+#include "hijack/stack_drainer.h"
+#include "hijack/utils.h"
+#include <algorithm>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <cerrno>
+#include <fstream>
+#include <ctime>
+#include <sys/stat.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+extern class process_collector process_collector;
+extern class stack_drainer stack_drainer;
+extern class stack_store stack_store;
+
+static const uint64_t NS_PER_SEC = 1000000000UL;
+static const uint64_t NS_PER_USEC = 1000UL;
+
+// 内核地址的起始位置,用户态地址不会超过这个值
+static const uint64_t KERNEL_ADDR_START = 0xffff000000000000UL;
+
+// folded 格式中分号是栈帧分隔符,只保留函数名
+static std::string fold_frame(const std::string &name)
+{
+	std::string frame = name.substr(0, name.find(" in "));
+	std::replace(frame.begin(), frame.end(), ';', ':');
+	return frame;
+}
+
+int profile_collector::start(struct hijack *skel)
+{
+	skel_ = skel;
+	last_drain_ns_ = boottime_ns();
+	last_pprof_ns_ = last_drain_ns_;
+
+	// 权限不足时内核栈无法符号化,只提示不退出
+	if (kallsyms_.load()) {
+		printf("kallsyms load failed\n");
+	}
+	return 0;
+}
+
+void profile_collector::collect()
+{
+	drain_offcpu();
+	drain_oncpu();
+	drain_lock();
+	drain_page_fault();
+	drain_go_offcpu();
+	drain_go_malloc();
+}
+
+// 只关心值中的 stackid, 键按 map 的大小读取
+template <typename V, typename F> static void for_each_value(const struct bpf_map *map, F fn)
+{
+	int fd = bpf_map__fd(map);
+	std::vector<char> key(bpf_map__key_size(map)), next_key(key.size());
+	void *prev_key = NULL;
+	V value;
+	while (!bpf_map_get_next_key(fd, prev_key, next_key.data())) {
+		key.swap(next_key);
+		prev_key = key.data();
+		if (!bpf_map_lookup_elem(fd, key.data(), &value))
+			fn(value);
+	}
+}
+
+std::unordered_set<uint32_t> profile_collector::pinned_stackids()
+{
+	std::unordered_set<uint32_t> pinned;
+	auto pin = [&](long stackid) {
+		if (stackid >= 0)
+			pinned.insert(stackid);
+	};
+
+	int fd = bpf_map__fd(skel_->maps.malloc_stack_map);
+	struct malloc_stack_key key, next_key;
+	struct malloc_stack_key *prev_key = NULL;
+	while (!bpf_map_get_next_key(fd, prev_key, &next_key)) {
+		key = next_key;
+		prev_key = &key;
+		pin(key.user_stackid);
+	}
+
+	// 切出后还没有切入的线程,切入时才会上报或者聚合
+	for_each_value<struct sched_switch_event>(skel_->maps.sched_switch_event_map, [&](const struct sched_switch_event &event) {
+		if (!event.offcpu_timestamp)
+			return;
+		pin(event.stackid);
+		pin(event.kernel_stackid);
+		if (event.waker_pid)
+			pin(event.waker_stackid);
+	});
+
+	// 还没有解锁的 pthread 锁和还没有被唤醒的协程
+	for_each_value<struct lock_hold_value>(skel_->maps.lock_hold_map,
+					       [&](const struct lock_hold_value &value) { pin(value.user_stackid); });
+	for_each_value<struct go_park_value>(skel_->maps.go_park_map, [&](const struct go_park_value &value) { pin(value.user_stackid); });
+	return pinned;
+}
+
+void profile_collector::drain()
+{
+	// 按需打印,不受取出间隔的限制
+	int malloc_report_tgid = malloc_report_tgid_.exchange(0, std::memory_order_relaxed);
+	if (malloc_report_tgid)
+		report_malloc(malloc_report_tgid);
+
+	uint64_t now = boottime_ns();
+	if (now - last_drain_ns_ < CONFIG_OFFCPU_AGGREGATE_INTERVAL * NS_PER_SEC)
+		return;
+	last_drain_ns_ = now;
+
+	for (auto &[path, folded] : folded_) {
+		write_folded(path.data(), folded);
+	}
+	folded_.clear();
+	report_lock();
+	comms_.clear();
+
+	if (now - last_pprof_ns_ >= CONFIG_PPROF_INTERVAL * NS_PER_SEC) {
+		export_pprof(now - last_pprof_ns_);
+		last_pprof_ns_ = now;
+	}
+}
+
+void profile_collector::drain_offcpu()
+{
+	std::vector<struct offcpu_aggregate_key> keys;
+	std::vector<struct offcpu_aggregate_value> values;
+	int ret = lookup_and_delete_all(bpf_map__fd(skel_->maps.offcpu_aggregate_map), keys, values, CONFIG_OFFCPU_AGGREGATE_MAX);
+	if (ret)
+		printf("offcpu_aggregate_map lookup_and_delete_batch failed: %d\n", ret);
+
+	// 同一个 folded 调用栈可能来自多个线程,合并后在 drain 时输出
+	std::unordered_map<std::string, uint64_t> &folded = folded_[CONFIG_OFFCPU_FOLDED_PATH];
+	for (size_t idx = 0; idx < keys.size(); ++idx) {
+		uintptr_t user_ip[CONFIG_MAX_STACK_DEPTH] = {};
+		uintptr_t kernel_ip[CONFIG_MAX_STACK_DEPTH] = {};
+		uintptr_t waker_ip[CONFIG_MAX_STACK_DEPTH] = {};
+		lookup_stack(keys[idx].user_stackid, user_ip);
+		lookup_stack(keys[idx].kernel_stackid, kernel_ip);
+
+		std::string stack = fold_stack(keys[idx].tgid, user_ip, kernel_ip);
+		if (keys[idx].waker_tgid) {
+			lookup_stack(keys[idx].waker_stackid, waker_ip);
+			stack += fold_waker_stack(keys[idx].waker_tgid, waker_ip);
+		}
+		folded[stack] += values[idx].duration / NS_PER_USEC;
+		record_pprof(keys[idx].tgid, user_ip, kernel_ip, PPROF_VALUE_OFFCPU_NS, values[idx].duration);
+		record_pprof(keys[idx].tgid, user_ip, kernel_ip, PPROF_VALUE_OFFCPU_COUNT, values[idx].count);
+	}
+}
+
+void profile_collector::drain_oncpu()
+{
+	std::vector<struct oncpu_aggregate_key> keys;
+	std::vector<uint64_t> values;
+	int ret = lookup_and_delete_all(bpf_map__fd(skel_->maps.oncpu_aggregate_map), keys, values, CONFIG_ONCPU_AGGREGATE_MAX);
+	if (ret)
+		printf("oncpu_aggregate_map lookup_and_delete_batch failed: %d\n", ret);
+
+	std::unordered_map<std::string, uint64_t> &folded = folded_[CONFIG_ONCPU_FOLDED_PATH];
+	for (size_t idx = 0; idx < keys.size(); ++idx) {
+		uintptr_t user_ip[CONFIG_MAX_STACK_DEPTH] = {};
+		uintptr_t kernel_ip[CONFIG_MAX_STACK_DEPTH] = {};
+		lookup_stack(keys[idx].user_stackid, user_ip);
+		lookup_stack(keys[idx].kernel_stackid, kernel_ip);
+
+		folded[fold_stack(keys[idx].tgid, user_ip, kernel_ip)] += values[idx];
+		record_pprof(keys[idx].tgid, user_ip, kernel_ip, PPROF_VALUE_ONCPU_COUNT, values[idx]);
+	}
+}
+
+void profile_collector::drain_page_fault()
+{
+	std::vector<struct page_fault_aggregate_key> keys;
+	std::vector<uint64_t> values;
+	int ret = lookup_and_delete_all(bpf_map__fd(skel_->maps.page_fault_aggregate_map), keys, values, CONFIG_PAGE_FAULT_AGGREGATE_MAX);
+	if (ret)
+		printf("page_fault_aggregate_map lookup_and_delete_batch failed: %d\n", ret);
+
+	std::unordered_map<std::string, uint64_t> &folded = folded_[CONFIG_PAGE_FAULT_FOLDED_PATH];
+	for (size_t idx = 0; idx < keys.size(); ++idx) {
+		uintptr_t user_ip[CONFIG_MAX_STACK_DEPTH] = {};
+		lookup_stack(keys[idx].user_stackid, user_ip);
+
+		folded[comm(keys[idx].tgid) + fold_user_stack(keys[idx].tgid, user_ip)] += values[idx];
+		record_pprof(keys[idx].tgid, user_ip, NULL, PPROF_VALUE_PAGE_FAULT_COUNT, values[idx]);
+	}
+}
+
+// runtime/runtime2.go 中 waitReason 的取值,不同的 Go 版本之间会有增减,这里与 Go 1.22 一致
+static const char *go_wait_reasons[] = {
+	"",
+	"GC assist marking",
+	"IO wait",
+	"chan receive (nil chan)",
+	"chan send (nil chan)",
+	"dumping heap",
+	"garbage collection",
+	"garbage collection scan",
+	"panicwait",
+	"select",
+	"select (no cases)",
+	"GC assist wait",
+	"GC sweep wait",
+	"GC scavenge wait",
+	"chan receive",
+	"chan send",
+	"finalizer wait",
+	"force gc (idle)",
+	"semacquire",
+	"sleep",
+	"sync.Cond.Wait",
+	"sync.Mutex.Lock",
+	"sync.RWMutex.RLock",
+	"sync.RWMutex.Lock",
+	"trace reader (blocked)",
+	"wait for GC cycle",
+	"GC worker (idle)",
+	"GC worker (active)",
+	"preempted",
+	"debug call",
+	"GC mark termination",
+	"stopping the world",
+	"flushing proc caches",
+	"trace goroutine status",
+	"trace proc status",
+	"page trace flush",
+	"coroutine",
+};
+
+static std::string go_wait_reason(int reason)
+{
+	if (reason > 0 && reason < (int)(sizeof(go_wait_reasons) / sizeof(go_wait_reasons[0])))
+		return go_wait_reasons[reason];
+	return "reason " + std::to_string(reason);
+}
+
+void profile_collector::drain_go_offcpu()
+{
+	std::vector<struct go_offcpu_aggregate_key> keys;
+	std::vector<struct offcpu_aggregate_value> values;
+	int ret = lookup_and_delete_all(bpf_map__fd(skel_->maps.go_offcpu_aggregate_map), keys, values, CONFIG_GO_OFFCPU_AGGREGATE_MAX);
+	if (ret)
+		printf("go_offcpu_aggregate_map lookup_and_delete_batch failed: %d\n", ret);
+
+	std::unordered_map<std::string, uint64_t> &folded = folded_[CONFIG_GO_OFFCPU_FOLDED_PATH];
+	for (size_t idx = 0; idx < keys.size(); ++idx) {
+		uintptr_t user_ip[CONFIG_MAX_STACK_DEPTH] = {};
+		lookup_stack(keys[idx].user_stackid, user_ip);
+
+		std::string reason = go_wait_reason(keys[idx].reason);
+		std::replace(reason.begin(), reason.end(), ' ', '_');
+		folded[comm(keys[idx].tgid) + fold_user_stack(keys[idx].tgid, user_ip) + ";[" + reason + "]"] += values[idx].duration / NS_PER_USEC;
+	}
+}
+
+void profile_collector::drain_go_malloc()
+{
+	std::vector<struct go_malloc_aggregate_key> keys;
+	std::vector<struct go_malloc_aggregate_value> values;
+	int ret = lookup_and_delete_all(bpf_map__fd(skel_->maps.go_malloc_aggregate_map), keys, values, CONFIG_GO_MALLOC_AGGREGATE_MAX);
+	if (ret)
+		printf("go_malloc_aggregate_map lookup_and_delete_batch failed: %d\n", ret);
+
+	std::unordered_map<std::string, uint64_t> &folded = folded_[CONFIG_GO_MALLOC_FOLDED_PATH];
+	for (size_t idx = 0; idx < keys.size(); ++idx) {
+		uintptr_t user_ip[CONFIG_MAX_STACK_DEPTH] = {};
+		lookup_stack(keys[idx].user_stackid, user_ip);
+
+		folded[comm(keys[idx].tgid) + fold_user_stack(keys[idx].tgid, user_ip)] += values[idx].bytes;
+		record_pprof(keys[idx].tgid, user_ip, NULL, PPROF_VALUE_GO_ALLOC_BYTES, values[idx].bytes);
+		record_pprof(keys[idx].tgid, user_ip, NULL, PPROF_VALUE_GO_ALLOC_COUNT, values[idx].count);
+	}
+}
+
+static const char *lock_type_name(int type)
+{
+	switch (type) {
+	case LOCK_TYPE_FUTEX:
+		return "futex";
+	case LOCK_TYPE_MUTEX:
+		return "mutex";
+	case LOCK_TYPE_RWLOCK_READ:
+		return "rwlock_read";
+	case LOCK_TYPE_RWLOCK_WRITE:
+		return "rwlock_write";
+	default:
+		return "unknown";
+	}
+}
+
+void profile_collector::drain_lock()
+{
+	std::vector<struct lock_aggregate_key> keys;
+	std::vector<struct lock_aggregate_value> values;
+	int ret = lookup_and_delete_all(bpf_map__fd(skel_->maps.lock_aggregate_map), keys, values, CONFIG_LOCK_AGGREGATE_MAX);
+	if (ret)
+		printf("lock_aggregate_map lookup_and_delete_batch failed: %d\n", ret);
+
+	for (size_t idx = 0; idx < keys.size(); ++idx) {
+		uintptr_t user_ip[CONFIG_MAX_STACK_DEPTH] = {};
+		lookup_stack(keys[idx].user_stackid, user_ip);
+
+		std::string stack = comm(keys[idx].tgid) + fold_user_stack(keys[idx].tgid, user_ip);
+		struct lock_aggregate_value &value = locks_[std::make_tuple((int)keys[idx].tgid, (int)keys[idx].type, (unsigned long long)keys[idx].addr, stack)];
+		value.duration += values[idx].duration;
+		value.count += values[idx].count;
+		if (values[idx].max > value.max)
+			value.max = values[idx].max;
+	}
+}
+
+// 按总时间从高到低打印, futex 为等待时间, pthread 锁为持有时间
+void profile_collector::report_lock()
+{
+	std::vector<decltype(locks_)::const_iterator> order;
+	for (auto it = locks_.cbegin(); it != locks_.cend(); ++it)
+		order.push_back(it);
+	std::sort(order.begin(), order.end(), [](auto a, auto b) { return a->second.duration > b->second.duration; });
+	if (order.size() > CONFIG_LOCK_TOP)
+		order.resize(CONFIG_LOCK_TOP);
+
+	for (auto it : order) {
+		auto &[tgid, type, addr, stack] = it->first;
+		printf("lock tgid=%d type=%s addr=0x%llx total=%lluus count=%llu max=%lluus stack=%s\n", tgid, lock_type_name(type), addr,
+		       it->second.duration / NS_PER_USEC, it->second.count, it->second.max / NS_PER_USEC, stack.data());
+	}
+	locks_.clear();
+}
+
+// 只读取不删除,未释放的字节数需要一直累计
+void profile_collector::report_malloc(int tgid)
+{
+	int fd = bpf_map__fd(skel_->maps.malloc_stack_map);
+	std::vector<struct malloc_stack_key> keys;
+	std::vector<struct malloc_stack_value> values;
+	struct malloc_stack_key key, next_key;
+	struct malloc_stack_key *prev_key = NULL;
+	while (!bpf_map_get_next_key(fd, prev_key, &next_key)) {
+		key = next_key;
+		prev_key = &key;
+
+		struct malloc_stack_value value;
+		if (next_key.tgid != tgid || bpf_map_lookup_elem(fd, &key, &value))
+			continue;
+		keys.push_back(key);
+		values.push_back(value);
+	}
+
+	auto print_top = [&](const char *kind, auto greater) {
+		std::vector<size_t> order(keys.size());
+		for (size_t idx = 0; idx < order.size(); ++idx)
+			order[idx] = idx;
+		std::sort(order.begin(), order.end(), greater);
+		if (order.size() > CONFIG_MALLOC_TOP)
+			order.resize(CONFIG_MALLOC_TOP);
+
+		for (size_t idx : order) {
+			uintptr_t user_ip[CONFIG_MAX_STACK_DEPTH] = {};
+			lookup_stack(keys[idx].user_stackid, user_ip);
+
+			printf("malloc %s tgid=%d outstanding=%lld total=%llu allocs=%llu frees=%llu stack=%s\n", kind, tgid,
+			       values[idx].outstanding, values[idx].total, values[idx].allocs, values[idx].frees,
+			       (comm(tgid) + fold_user_stack(tgid, user_ip)).data());
+		}
+	};
+
+	// 长时间未释放的字节数多的调用栈可能存在泄漏,累计分配多的调用栈是分配热点
+	print_top("outstanding", [&](size_t a, size_t b) { return values[a].outstanding > values[b].outstanding; });
+	print_top("total", [&](size_t a, size_t b) { return values[a].total > values[b].total; });
+}
+
+void profile_collector::write_folded(const char *path, const std::unordered_map<std::string, uint64_t> &folded)
+{
+	if (folded.empty())
+		return;
+
+	// 只保留一份历史文件,超过大小后覆盖上一份
+	struct stat st;
+	if (!stat(path, &st) && st.st_size >= CONFIG_FOLDED_SIZE_MAX) {
+		std::string old = std::string(path) + ".1";
+		if (rename(path, old.data()))
+			printf("rename %s failed: %d\n", path, errno);
+	}
+
+	FILE *file = fopen(path, "a");
+	if (!file) {
+		printf("open %s failed: %d\n", path, errno);
+		return;
+	}
+	for (auto &[stack, value] : folded) {
+		fprintf(file, "%s %lu\n", stack.data(), value);
+	}
+	fclose(file);
+}
+
+int profile_collector::start_oncpu_sample(int frequency)
+{
+	stop_oncpu_sample();
+
+	int ncpus = libbpf_num_possible_cpus();
+	for (int cpu = 0; cpu < ncpus; ++cpu) {
+		struct perf_event_attr attr = {};
+		attr.type = PERF_TYPE_SOFTWARE;
+		attr.config = PERF_COUNT_SW_CPU_CLOCK;
+		attr.size = sizeof(attr);
+		attr.freq = 1;
+		attr.sample_freq = frequency;
+
+		int fd = syscall(__NR_perf_event_open, &attr, -1, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+		if (fd < 0) {
+			// 不在线的 CPU 返回 ENODEV, 跳过即可
+			if (errno == ENODEV)
+				continue;
+			printf("perf_event_open failed: cpu=%d errno=%d\n", cpu, errno);
+			stop_oncpu_sample();
+			return -errno;
+		}
+
+		struct bpf_link *link = bpf_program__attach_perf_event(skel_->progs.oncpu_sample, fd);
+		if (!link) {
+			printf("bpf_program__attach_perf_event failed: cpu=%d errno=%d\n", cpu, errno);
+			close(fd);
+			stop_oncpu_sample();
+			return -errno;
+		}
+		oncpu_links_.push_back(link);
+	}
+
+	return 0;
+}
+
+void profile_collector::stop_oncpu_sample()
+{
+	// perf_event 的 fd 由 bpf_link 持有,销毁 link 时一起关闭
+	for (struct bpf_link *link : oncpu_links_) {
+		bpf_link__destroy(link);
+	}
+	oncpu_links_.clear();
+}
+
+bool profile_collector::oncpu_sample_running()
+{
+	return !oncpu_links_.empty();
+}
+
+int profile_collector::lookup_stack(long stackid, uintptr_t *ip)
+{
+	if (stackid < 0)
+		return -1;
+	return stack_drainer.lookup(stackid, ip);
+}
+
+std::string profile_collector::fold_stack(int tgid, const uintptr_t *user_ip, const uintptr_t *kernel_ip)
+{
+	return comm(tgid) + fold_user_stack(tgid, user_ip) + fold_kernel_stack(kernel_ip);
+}
+
+std::string profile_collector::fold_user_stack(int tgid, const uintptr_t *ip)
+{
+	struct binary *binary_ctx = process_collector.fetch_binnary_ctx(tgid);
+	if (!ip[0] || !binary_ctx)
+		return ";[unknown]";
+
+	// 调用栈样本只用来缓存符号化结果
+	bool created;
+	struct stack_sample *sample = stack_store.record(STACK_KIND_PROFILE, tgid, binary_ctx, ip, &created);
+	const struct stack &stack = stack_store.lookup_stack(sample->hash);
+
+	std::string folded;
+	for (auto it = stack.frames.rbegin(); it != stack.frames.rend(); ++it) {
+		folded += ";" + fold_frame(stack_store.lookup_frame(*it));
+	}
+	return folded;
+}
+
+// 与 offwaketime 的输出格式一致,唤醒者的调用栈以 -- 分隔,从栈顶开始倒序排列,最后是唤醒者的进程名
+std::string profile_collector::fold_waker_stack(int tgid, const uintptr_t *ip)
+{
+	std::string folded = ";--";
+	std::string user = fold_user_stack(tgid, ip);
+
+	// fold_user_stack 从栈底开始,这里按帧拆开后倒序拼接
+	std::vector<std::string> frames;
+	size_t pos = 0;
+	while (pos < user.size()) {
+		size_t next = user.find(';', pos + 1);
+		frames.push_back(user.substr(pos, next - pos));
+		pos = next == std::string::npos ? user.size() : next;
+	}
+	for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+		folded += *it;
+	}
+	return folded + ";" + comm(tgid);
+}
+
+std::string profile_collector::fold_kernel_stack(const uintptr_t *ip)
+{
+	int nr = 0;
+	while (nr < CONFIG_MAX_STACK_DEPTH && ip[nr])
+		++nr;
+
+	// 内核栈帧加上 _[k] 后缀, flamegraph.pl 会用不同的颜色显示
+	std::string folded;
+	for (int idx = nr - 1; idx >= 0; --idx) {
+		std::string name = kallsyms_.lookup(ip[idx]);
+		folded += ";" + (name.empty() ? std::string("[unknown]") : name) + "_[k]";
+	}
+	return folded;
+}
+
+std::string profile_collector::kernel_symbol(uint64_t addr)
+{
+	return kallsyms_.lookup(addr);
+}
+
+void profile_collector::set_pprof_enabled(bool enabled)
+{
+	pprof_enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void profile_collector::request_malloc_report(int tgid)
+{
+	malloc_report_tgid_.store(tgid, std::memory_order_relaxed);
+}
+
+// 先取出全部键再删除,避免遍历过程中删除导致重新从头开始
+template <typename K> static void delete_by_tgid(int fd, int tgid)
+{
+	std::vector<K> keys;
+	K key, next_key;
+	K *prev_key = NULL;
+	while (!bpf_map_get_next_key(fd, prev_key, &next_key)) {
+		key = next_key;
+		prev_key = &key;
+		if (key.tgid == tgid)
+			keys.push_back(key);
+	}
+	for (auto &key : keys) {
+		bpf_map_delete_elem(fd, &key);
+	}
+}
+
+void profile_collector::clear_malloc(int tgid)
+{
+	delete_by_tgid<struct malloc_stack_key>(bpf_map__fd(skel_->maps.malloc_stack_map), tgid);
+	delete_by_tgid<struct malloc_alloc_key>(bpf_map__fd(skel_->maps.malloc_alloc_map), tgid);
+}
+
+void profile_collector::record_pprof(int tgid, const uintptr_t *user_ip, const uintptr_t *kernel_ip, int type, int64_t value)
+{
+	if (!pprof_enabled_.load(std::memory_order_relaxed))
+		return;
+
+	// 从栈顶开始,内核栈在前,用户栈在后
+	std::vector<uint64_t> ip;
+	for (int idx = 0; kernel_ip && idx < CONFIG_MAX_STACK_DEPTH && kernel_ip[idx]; ++idx) {
+		ip.push_back(kernel_ip[idx]);
+	}
+	for (int idx = 0; user_ip && idx < CONFIG_MAX_STACK_DEPTH && user_ip[idx]; ++idx) {
+		ip.push_back(user_ip[idx]);
+	}
+
+	auto &samples = pprof_samples_[tgid];
+	auto it = samples.find(ip);
+	if (it == samples.end()) {
+		if (samples.size() >= CONFIG_PPROF_SAMPLE_MAX)
+			return;
+		it = samples.emplace(std::move(ip), std::vector<int64_t>(PPROF_VALUE_MAX)).first;
+	}
+	it->second[type] += value;
+}
+
+void profile_collector::export_pprof(uint64_t duration)
+{
+	if (pprof_samples_.empty())
+		return;
+
+	if (mkdir(CONFIG_PPROF_PATH, 0755) && errno != EEXIST) {
+		printf("mkdir %s failed: %d\n", CONFIG_PPROF_PATH, errno);
+		pprof_samples_.clear();
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	int64_t time_nanos = now.tv_sec * NS_PER_SEC + now.tv_nsec - duration;
+
+	for (auto &[tgid, samples] : pprof_samples_) {
+		class pprof_profile profile(pprof_sample_types(), time_nanos, duration);
+		struct binary *binary_ctx = process_collector.fetch_binnary_ctx(tgid);
+		std::vector<struct pprof_mapping> mappings = read_pprof_mappings(tgid, profile);
+
+		for (auto &[ip, values] : samples) {
+			std::vector<uint64_t> locations;
+			for (uint64_t addr : ip) {
+				locations.push_back(pprof_location(profile, mappings, binary_ctx, addr));
+			}
+			profile.add_sample(locations, values);
+		}
+
+		std::string compressed;
+		if (gzip_compress(profile.encode(), compressed)) {
+			printf("gzip_compress failed: tgid=%d\n", tgid);
+			continue;
+		}
+
+		std::string path = std::string(CONFIG_PPROF_PATH) + "/" + std::to_string(tgid) + "-" + std::to_string(now.tv_sec) + ".pb.gz";
+		FILE *file = fopen(path.data(), "w");
+		if (!file) {
+			printf("open %s failed: %d\n", path.data(), errno);
+			continue;
+		}
+		fwrite(compressed.data(), 1, compressed.size(), file);
+		fclose(file);
+	}
+
+	pprof_samples_.clear();
+}
+
+const std::vector<std::pair<std::string, std::string>> &profile_collector::pprof_sample_types()
+{
+	// 顺序与 PPROF_VALUE_* 一致
+	static const std::vector<std::pair<std::string, std::string>> types = {
+		{"offcpu", "nanoseconds"},
+		{"offcpu", "count"},
+		{"call_stack", "count"},
+		{"page_fault", "count"},
+		{"oncpu", "count"},
+		{"alloc_space", "bytes"},
+		{"alloc_objects", "count"},
+	};
+	static_assert(PPROF_VALUE_MAX == 7, "pprof_sample_types out of sync with PPROF_VALUE_*");
+	return types;
+}
+
+// 读取进程中可执行的映射,内核地址统一放在一个映射中
+std::vector<struct profile_collector::pprof_mapping> profile_collector::read_pprof_mappings(int tgid, class pprof_profile &profile)
+{
+	std::vector<struct pprof_mapping> mappings;
+	std::ifstream infile("/proc/" + std::to_string(tgid) + "/maps");
+	std::string line;
+
+	while (std::getline(infile, line)) {
+		uint64_t start, limit, offset;
+		char perms[8] = {};
+		char filename[256] = {};
+		if (sscanf(line.data(), "%lx-%lx %7s %lx %*s %*s %255s", &start, &limit, perms, &offset, filename) < 4)
+			continue;
+		if (perms[2] != 'x')
+			continue;
+		mappings.push_back({start, limit, profile.add_mapping(start, limit, offset, filename)});
+	}
+
+	mappings.push_back({KERNEL_ADDR_START, UINT64_MAX, profile.add_mapping(KERNEL_ADDR_START, UINT64_MAX, 0, "[kernel.kallsyms]")});
+	return mappings;
+}
+
+uint64_t profile_collector::pprof_location(class pprof_profile &profile, const std::vector<struct pprof_mapping> &mappings, struct binary *binary_ctx,
+					   uint64_t addr)
+{
+	uint64_t mapping_id = 0;
+	for (const struct pprof_mapping &mapping : mappings) {
+		if (addr >= mapping.start && addr < mapping.limit) {
+			mapping_id = mapping.id;
+			break;
+		}
+	}
+
+	// 同一个地址只符号化一次
+	uint64_t id = profile.find_location(mapping_id, addr);
+	if (id)
+		return id;
+
+	if (addr >= KERNEL_ADDR_START) {
+		std::string name = kallsyms_.lookup(addr);
+		return profile.add_location(mapping_id, addr, name.empty() ? "[unknown]" : name, "", 0);
+	}
+
+	struct symbol {
+		std::string function = "[unknown]";
+		std::string filename;
+		int64_t line = 0;
+	} symbol;
+	if (binary_ctx) {
+		binary_addr_to_line(
+			binary_ctx, addr,
+			[](bfd_vma pc, const char *functionname, const char *filename, int line, void *data) {
+				struct symbol *symbol = (struct symbol *)data;
+				symbol->function = functionname ? functionname : "[unknown]";
+				symbol->filename = filename ? filename : "";
+				symbol->line = line;
+			},
+			&symbol);
+	}
+	return profile.add_location(mapping_id, addr, symbol.function, symbol.filename, symbol.line);
+}
+
+std::string profile_collector::comm(int tgid)
+{
+	auto it = comms_.find(tgid);
+	if (it != comms_.end())
+		return it->second;
+
+	std::string name;
+	std::ifstream infile("/proc/" + std::to_string(tgid) + "/comm");
+	if (!std::getline(infile, name) || name.empty())
+		name = std::to_string(tgid);
+	std::replace(name.begin(), name.end(), ';', ':');
+	std::replace(name.begin(), name.end(), ' ', '_');
+
+	comms_[tgid] = name;
+	return name;
+}
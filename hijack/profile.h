@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_PROFILE_H
+#define HIJACK_PROFILE_H
+
+#include "hijack-common/types.h"
+#include "hijack/hijack.skel.h"
+#include "hijack/binary.h"
+#include "hijack/kallsyms.h"
+#include "hijack/pprof.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// pprof 中每个样本的数值列
+enum {
+	PPROF_VALUE_OFFCPU_NS,
+	PPROF_VALUE_OFFCPU_COUNT,
+	PPROF_VALUE_CALL_STACK_COUNT,
+	PPROF_VALUE_PAGE_FAULT_COUNT,
+	PPROF_VALUE_ONCPU_COUNT,
+	PPROF_VALUE_GO_ALLOC_BYTES,
+	PPROF_VALUE_GO_ALLOC_COUNT,
+	PPROF_VALUE_MAX,
+};
+
+// 定期输出内核中聚合的 offcpu 和 oncpu 数据,以 folded 格式分别追加到 CONFIG_OFFCPU_FOLDED_PATH 和 CONFIG_ONCPU_FOLDED_PATH,
+// 每行为 "进程名;用户栈;内核栈 数值", offcpu 记录到唤醒者时在后面追加 ";--;唤醒者调用栈;唤醒者进程名", offcpu 的数值为微秒, oncpu 的数值为采样次数, 可以直接交给 flamegraph.pl 生成火焰图.
+// 协程 offcpu 以 "进程名;用户栈;[挂起原因] 微秒" 的格式追加到 CONFIG_GO_OFFCPU_FOLDED_PATH.
+// 页错误聚合后以 "进程名;用户栈 次数" 的格式追加到 CONFIG_PAGE_FAULT_FOLDED_PATH.
+// Go 堆内存分配以 "进程名;用户栈 字节数" 的格式追加到 CONFIG_GO_MALLOC_FOLDED_PATH.
+// folded 文件超过 CONFIG_FOLDED_SIZE_MAX 字节时重命名为 <文件名>.1 后重新开始,只保留一份历史.
+// 同时取出 futex 的等待时间和 pthread 锁的持有时间,按总时间打印前 CONFIG_LOCK_TOP 个锁及其 folded 调用栈.
+// 内存分配的统计常驻内核,不随 drain 清空,收到 request_malloc_report 后在主线程下次循环时打印.
+// 开启 pprof 后,同时按进程累计各类调用栈,每 CONFIG_PPROF_INTERVAL 秒写入 CONFIG_PPROF_PATH 目录下的 <tgid>-<时间戳>.pb.gz.
+// drain 和 record_pprof 只在主线程调用, oncpu 采样的开关只在控制线程调用,两者没有共享的状态,不加锁.
+class profile_collector {
+    public:
+	int start(struct hijack *skel);
+
+	// 取出内核中按 stackid 聚合的数据,累计到用户态. 必须在 stack_drainer 清理 stack_trace_map 之前调用,
+	// 清理后 stackid 会被重新分配,留在内核中的聚合结果会被符号化为其他调用栈
+	void collect();
+
+	// 内核中还在被引用的 stackid, 包括内存分配统计、切出的线程、持有的锁和挂起的协程, stack_drainer 清理时需要跳过
+	std::unordered_set<uint32_t> pinned_stackids();
+
+	// 距离上次输出超过 CONFIG_OFFCPU_AGGREGATE_INTERVAL 秒时把累计的结果写入文件
+	void drain();
+
+	// 在每个 CPU 上以 frequency 赫兹的频率采样,已经在采样时按新的频率重新开始
+	int start_oncpu_sample(int frequency);
+	void stop_oncpu_sample();
+	bool oncpu_sample_running();
+
+	// 可以在其他线程调用
+	void set_pprof_enabled(bool enabled);
+	void request_malloc_report(int tgid);
+	// 删除进程在内核中的内存分配统计,只操作内核中的 map, 可以在其他线程调用
+	void clear_malloc(int tgid);
+
+	// 内核地址所在的函数名,与内核栈的 folded 格式共用符号表,只在主线程调用
+	std::string kernel_symbol(uint64_t addr);
+
+	// 累计一个样本, user_ip 和 kernel_ip 以 0 结尾,可以为 NULL, type 为 PPROF_VALUE_*
+	void record_pprof(int tgid, const uintptr_t *user_ip, const uintptr_t *kernel_ip, int type, int64_t value);
+
+    private:
+	struct pprof_mapping {
+		uint64_t start;
+		uint64_t limit;
+		uint64_t id;
+	};
+
+	void drain_offcpu();
+	void drain_oncpu();
+	void drain_lock();
+	void drain_page_fault();
+	void drain_go_offcpu();
+	void drain_go_malloc();
+	void report_lock();
+	void report_malloc(int tgid);
+	void write_folded(const char *path, const std::unordered_map<std::string, uint64_t> &folded);
+	int lookup_stack(long stackid, uintptr_t *ip);
+	std::string fold_stack(int tgid, const uintptr_t *user_ip, const uintptr_t *kernel_ip);
+	std::string fold_user_stack(int tgid, const uintptr_t *ip);
+	std::string fold_kernel_stack(const uintptr_t *ip);
+	std::string fold_waker_stack(int tgid, const uintptr_t *ip);
+	std::string comm(int tgid);
+
+	void export_pprof(uint64_t duration);
+	static const std::vector<std::pair<std::string, std::string>> &pprof_sample_types();
+	std::vector<struct pprof_mapping> read_pprof_mappings(int tgid, class pprof_profile &profile);
+	uint64_t pprof_location(class pprof_profile &profile, const std::vector<struct pprof_mapping> &mappings, struct binary *binary_ctx, uint64_t addr);
+
+	struct hijack *skel_;
+	uint64_t last_drain_ns_;
+	class kallsyms kallsyms_;
+	std::unordered_map<int, std::string> comms_;
+	// 输出文件 -> folded 调用栈 -> 数值, 每次 drain 时写入并清空
+	std::unordered_map<std::string, std::unordered_map<std::string, uint64_t>> folded_;
+	// (tgid, 锁类型, 锁地址, folded 调用栈) -> 累计值
+	std::map<std::tuple<int, int, unsigned long long, std::string>, struct lock_aggregate_value> locks_;
+	std::vector<struct bpf_link *> oncpu_links_;
+
+	std::atomic<bool> pprof_enabled_ = false;
+	std::atomic<int> malloc_report_tgid_ = 0;
+	uint64_t last_pprof_ns_;
+	// tgid -> 从栈顶开始的地址 -> 各列数值
+	std::unordered_map<int, std::map<std::vector<uint64_t>, std::vector<int64_t>>> pprof_samples_;
+};
+
+#endif
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/prog_stats.h"
+#include "hijack-common/types.h"
+#include "hijack/metrics.h"
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+
+static_assert(sizeof(struct ctl_prog_stats) <= CONFIG_CTL_BUFFER_SIZE_MAX, "CONFIG_CTL_BUFFER_SIZE_MAX too small");
+
+int prog_stats::start(struct hijack *skel)
+{
+	skel_ = skel;
+	ncpus_ = sysconf(_SC_NPROCESSORS_ONLN);
+	last_sample_ns_ = boottime_ns();
+
+	// 内核版本过低或者权限不足时开启失败,sysctl kernel.bpf_stats_enabled 开启时依然可以读到数据,这里只提示不退出
+	stats_fd_ = bpf_enable_stats(BPF_STATS_RUN_TIME);
+	if (stats_fd_ < 0) {
+		printf("bpf_enable_stats failed: %d\n", stats_fd_);
+	}
+
+	std::thread sample_thread([&]() {
+		while (true) {
+			std::this_thread::sleep_for(std::chrono::seconds(CONFIG_PROG_STATS_INTERVAL));
+			sample();
+		}
+	});
+	sample_thread.detach();
+	return 0;
+}
+
+void prog_stats::sample()
+{
+	uint64_t now = boottime_ns();
+	uint64_t elapsed = now - last_sample_ns_;
+	last_sample_ns_ = now;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	struct bpf_program *prog;
+	bpf_object__for_each_program(prog, skel_->obj) {
+		int fd = bpf_program__fd(prog);
+		if (fd < 0)
+			continue;
+
+		struct bpf_prog_info info = {};
+		__u32 len = sizeof(info);
+		if (bpf_prog_get_info_by_fd(fd, &info, &len))
+			continue;
+
+		struct prog_stat &stat = stats_[bpf_program__name(prog)];
+		uint64_t run_cnt = info.run_cnt - stat.run_cnt;
+		uint64_t run_time_ns = info.run_time_ns - stat.run_time_ns;
+
+		stat.name = bpf_program__name(prog);
+		stat.run_cnt = info.run_cnt;
+		stat.run_time_ns = info.run_time_ns;
+		stat.ns_per_run = run_cnt ? run_time_ns / run_cnt : 0;
+		stat.cpu_share_ppm = (elapsed && ncpus_ > 0) ? run_time_ns * 1000000 / (elapsed * ncpus_) : 0;
+	}
+}
+
+std::vector<struct prog_stat> prog_stats::snapshot()
+{
+	std::vector<struct prog_stat> retval;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (auto const &[name, stat] : stats_) {
+		retval.push_back(stat);
+	}
+	return retval;
+}
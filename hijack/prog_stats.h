@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_PROG_STATS_H
+#define HIJACK_PROG_STATS_H
+
+#include "hijack/hijack.skel.h"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct prog_stat {
+	std::string name;
+	uint64_t run_cnt;
+	uint64_t run_time_ns;
+	uint64_t ns_per_run;
+	uint64_t cpu_share_ppm;
+};
+
+// 周期性读取骨架中每个 eBPF 程序的 run_cnt/run_time_ns.
+// 内核只在 BPF_STATS_RUN_TIME 开启期间统计,开启状态由 bpf_enable_stats 返回的 fd 维持,hijack 退出时自动关闭.
+class prog_stats {
+    public:
+	int start(struct hijack *skel);
+
+	// 拷贝最近一次采样的结果,可以在其他线程调用
+	std::vector<struct prog_stat> snapshot();
+
+    private:
+	void sample();
+
+	struct hijack *skel_;
+	int stats_fd_;
+	int ncpus_;
+	uint64_t last_sample_ns_;
+	std::mutex mutex_;
+	std::map<std::string, struct prog_stat> stats_;
+};
+
+#endif
@@ -0,0 +1,344 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/python.h"
+#include "hijack/binary.h"
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <cctype>
+#include <cerrno>
+#include <elf.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <sys/uio.h>
+
+// 不同版本的解释器结构体布局不同,新增版本时在这里添加一项
+struct python_version {
+	const char *version;
+	// _PyRuntime.gilstate.tstate_current 的偏移
+	unsigned int runtime_tstate_current;
+	struct python_proc_cfg cfg;
+
+	// 以下为用户态读取 PyCodeObject 时使用的偏移
+	unsigned int code_qualname;
+	unsigned int code_filename;
+	unsigned int code_firstlineno;
+	unsigned int code_linetable;
+	unsigned int unicode_length;
+	unsigned int unicode_state;
+	unsigned int ascii_data;
+	unsigned int compact_utf8_length;
+	unsigned int compact_utf8;
+	unsigned int bytes_size;
+	unsigned int bytes_data;
+};
+
+static const struct python_version python_versions[] = {
+	{
+		.version = "3.11",
+		.runtime_tstate_current = 576,
+		.cfg = {
+			.tstate_cframe = 56,
+			.tstate_thread_id = 152,
+			.cframe_current_frame = 8,
+			.frame_code = 32,
+			.frame_previous = 48,
+			.frame_prev_instr = 56,
+			.code_code_adaptive = 184,
+		},
+		.code_qualname = 128,
+		.code_filename = 112,
+		.code_firstlineno = 72,
+		.code_linetable = 136,
+		.unicode_length = 16,
+		.unicode_state = 32,
+		.ascii_data = 48,
+		.compact_utf8_length = 48,
+		.compact_utf8 = 56,
+		.bytes_size = 16,
+		.bytes_data = 32,
+	},
+};
+
+// 读取字符串和 co_linetable 时的长度上限,避免读到损坏的对象时分配过多内存
+static const size_t PYTHON_STRING_MAX = 1024;
+static const size_t PYTHON_LINETABLE_MAX = 65536;
+
+static int read_memory(int pid, uint64_t addr, void *buffer, size_t len)
+{
+	struct iovec local = { .iov_base = buffer, .iov_len = len };
+	struct iovec remote = { .iov_base = (void *)addr, .iov_len = len };
+	ssize_t size = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+	return size == (ssize_t)len ? 0 : -1;
+}
+
+template <typename T> static T read_value(int pid, uint64_t addr)
+{
+	T value = {};
+	read_memory(pid, addr, &value, sizeof(value));
+	return value;
+}
+
+// 只处理 compact 的 str 对象,其他情况返回空字符串
+static std::string read_unicode(int pid, const struct python_version &v, uint64_t addr)
+{
+	if (!addr)
+		return "";
+
+	unsigned int state = read_value<unsigned int>(pid, addr + v.unicode_state);
+	bool compact = state & (1 << 5);
+	bool ascii = state & (1 << 6);
+	if (!compact)
+		return "";
+
+	uint64_t data;
+	size_t length;
+	if (ascii) {
+		data = addr + v.ascii_data;
+		length = read_value<int64_t>(pid, addr + v.unicode_length);
+	} else {
+		data = read_value<uint64_t>(pid, addr + v.compact_utf8);
+		length = read_value<int64_t>(pid, addr + v.compact_utf8_length);
+	}
+	if (!data || length > PYTHON_STRING_MAX)
+		return "";
+
+	std::string str(length, '\0');
+	if (read_memory(pid, data, str.data(), length))
+		return "";
+	return str;
+}
+
+static std::string read_bytes(int pid, const struct python_version &v, uint64_t addr)
+{
+	if (!addr)
+		return "";
+
+	size_t size = read_value<int64_t>(pid, addr + v.bytes_size);
+	if (size > PYTHON_LINETABLE_MAX)
+		return "";
+
+	std::string bytes(size, '\0');
+	if (read_memory(pid, addr + v.bytes_data, bytes.data(), size))
+		return "";
+	return bytes;
+}
+
+static unsigned int read_varint(const std::string &table, size_t &pos)
+{
+	unsigned int value = 0;
+	unsigned int shift = 0;
+	while (pos < table.size()) {
+		unsigned char byte = table[pos++];
+		value |= (byte & 63) << shift;
+		shift += 6;
+		if (!(byte & 64))
+			break;
+	}
+	return value;
+}
+
+static int read_svarint(const std::string &table, size_t &pos)
+{
+	unsigned int value = read_varint(table, pos);
+	return (value & 1) ? -(int)(value >> 1) : (int)(value >> 1);
+}
+
+int python_linetable_lookup(const std::string &linetable, int firstlineno, int lasti)
+{
+	int line = firstlineno;
+	int addr = 0;
+	size_t pos = 0;
+	while (pos < linetable.size()) {
+		unsigned char first = linetable[pos++];
+		int code = (first >> 3) & 15;
+		int length = (first & 7) + 1;
+
+		int delta = 0;
+		bool none = false;
+		if (code == 15) {
+			none = true;
+		} else if (code == 14) {
+			// 行号增量, 结束行增量, 起始列, 结束列
+			delta = read_svarint(linetable, pos);
+			read_varint(linetable, pos);
+			read_varint(linetable, pos);
+			read_varint(linetable, pos);
+		} else if (code == 13) {
+			delta = read_svarint(linetable, pos);
+		} else if (code >= 10) {
+			delta = code - 10;
+			pos += 2;
+		} else {
+			pos += 1;
+		}
+		line += delta;
+
+		if (lasti >= addr && lasti < addr + length)
+			return none ? -1 : line;
+		addr += length;
+	}
+	return -1;
+}
+
+// 返回 offset 为 0 的第一段映射的起始地址,映射的文件满足 match
+template <typename F> static uint64_t find_mapping(int pid, F match, std::string &path)
+{
+	std::ifstream infile("/proc/" + std::to_string(pid) + "/maps");
+	std::string line;
+	while (std::getline(infile, line)) {
+		std::string range, perms, offset, dev, inode;
+		std::istringstream iss(line);
+		if (!(iss >> range >> perms >> offset >> dev >> inode >> path))
+			continue;
+		if (std::stoull(offset, nullptr, 16) != 0 || !match(path))
+			continue;
+		return std::stoull(range.substr(0, range.find('-')), nullptr, 16);
+	}
+	path.clear();
+	return 0;
+}
+
+// 第一个 PT_LOAD 段的虚拟地址,共享库和 PIE 中通常为 0
+static uint64_t first_load_vaddr(const std::string &filename)
+{
+	std::ifstream infile(filename, std::ios::binary);
+	Elf64_Ehdr ehdr;
+	if (!infile.read((char *)&ehdr, sizeof(ehdr)) || memcmp(ehdr.e_ident, ELFMAG, SELFMAG))
+		return 0;
+
+	uint64_t vaddr = UINT64_MAX;
+	for (int idx = 0; idx < ehdr.e_phnum; ++idx) {
+		Elf64_Phdr phdr;
+		infile.seekg(ehdr.e_phoff + idx * ehdr.e_phentsize);
+		if (!infile.read((char *)&phdr, sizeof(phdr)))
+			break;
+		if (phdr.p_type == PT_LOAD && phdr.p_vaddr < vaddr)
+			vaddr = phdr.p_vaddr & ~(phdr.p_align - 1);
+	}
+	return vaddr == UINT64_MAX ? 0 : vaddr;
+}
+
+// _PyRuntime 是导出的数据符号,优先从动态符号表中查找
+static uint64_t find_symbol(const std::string &filename, const char *symbol)
+{
+	bfd *abfd = bfd_openr(filename.data(), NULL);
+	if (!abfd)
+		return 0;
+
+	uint64_t addr = 0;
+	if (bfd_check_format(abfd, bfd_object)) {
+		for (bool dynamic : { true, false }) {
+			long storage = dynamic ? bfd_get_dynamic_symtab_upper_bound(abfd) : bfd_get_symtab_upper_bound(abfd);
+			if (storage <= 0)
+				continue;
+
+			std::vector<asymbol *> syms(storage / sizeof(asymbol *) + 1);
+			long nsym = dynamic ? bfd_canonicalize_dynamic_symtab(abfd, syms.data()) : bfd_canonicalize_symtab(abfd, syms.data());
+			for (long idx = 0; idx < nsym && !addr; ++idx) {
+				if (!strcmp(bfd_asymbol_name(syms[idx]), symbol))
+					addr = bfd_asymbol_value(syms[idx]);
+			}
+			if (addr)
+				break;
+		}
+	}
+	bfd_close(abfd);
+	return addr;
+}
+
+int python_unwinder::enable(struct hijack *skel, int tgid)
+{
+	// 动态链接时解释器在 libpython3.x.so 中,否则在可执行文件中
+	std::string path;
+	std::string version;
+	uint64_t start = find_mapping(
+		tgid, [](const std::string &file) { return std::filesystem::path(file).filename().string().starts_with("libpython3."); }, path);
+	std::string filename = "/proc/" + std::to_string(tgid) + "/root" + path;
+	if (start) {
+		version = std::filesystem::path(path).filename().string().substr(strlen("libpython"));
+	} else {
+		std::error_code ec;
+		std::string exe = std::filesystem::read_symlink("/proc/" + std::to_string(tgid) + "/exe", ec).string();
+		std::string name = std::filesystem::path(exe).filename().string();
+		if (ec || !name.starts_with("python"))
+			return -ENOTSUP;
+		start = find_mapping(tgid, [&](const std::string &file) { return file == exe; }, path);
+		version = name.substr(strlen("python"));
+		filename = "/proc/" + std::to_string(tgid) + "/exe";
+	}
+	if (!start)
+		return -ENOTSUP;
+
+	for (unsigned int idx = 0; idx < sizeof(python_versions) / sizeof(python_versions[0]); ++idx) {
+		const struct python_version &v = python_versions[idx];
+		if (!version.starts_with(v.version) || (version.size() > strlen(v.version) && isdigit(version[strlen(v.version)])))
+			continue;
+
+		uint64_t runtime = find_symbol(filename, "_PyRuntime");
+		if (!runtime)
+			return -ENOENT;
+
+		struct python_proc_cfg cfg = v.cfg;
+		cfg.tstate_current = start - first_load_vaddr(filename) + runtime + v.runtime_tstate_current;
+		cfg.version = idx;
+		if (bpf_map_update_elem(bpf_map__fd(skel->maps.python_proc_map), &tgid, &cfg, BPF_ANY))
+			return -errno;
+		return 0;
+	}
+
+	printf("python version %s not supported: tgid=%d\n", version.data(), tgid);
+	return -ENOTSUP;
+}
+
+int python_unwinder::disable(struct hijack *skel, int tgid)
+{
+	bpf_map_delete_elem(bpf_map__fd(skel->maps.python_proc_map), &tgid);
+	return 0;
+}
+
+struct python_unwinder::code *python_unwinder::lookup_code(int tgid, unsigned int version, uint64_t addr)
+{
+	const struct python_version &v = python_versions[version];
+	int firstlineno = read_value<int>(tgid, addr + v.code_firstlineno);
+	uint64_t linetable = read_value<uint64_t>(tgid, addr + v.code_linetable);
+
+	// 代码对象释放后地址会被复用,起始行号和 co_linetable 的地址都没变时才认为是同一个对象
+	auto &codes = codes_[tgid];
+	auto it = codes.find(addr);
+	if (it != codes.end() && it->second.firstlineno == firstlineno && it->second.linetable_addr == linetable)
+		return &it->second;
+
+	// 动态生成的代码对象可能很多,超过上限时整体清空
+	if (it == codes.end() && codes.size() >= CONFIG_PYTHON_CODE_CACHE_MAX)
+		codes.clear();
+
+	struct code &code = codes[addr];
+	code.name = read_unicode(tgid, v, read_value<uint64_t>(tgid, addr + v.code_qualname));
+	code.filename = read_unicode(tgid, v, read_value<uint64_t>(tgid, addr + v.code_filename));
+	code.firstlineno = firstlineno;
+	code.linetable_addr = linetable;
+	code.linetable = read_bytes(tgid, v, linetable);
+	return &code;
+}
+
+std::vector<std::string> python_unwinder::symbolize(struct hijack *skel, int tgid, const struct python_frame *frames, int nr)
+{
+	std::vector<std::string> result;
+
+	struct python_proc_cfg cfg;
+	if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.python_proc_map), &tgid, &cfg) || cfg.version >= sizeof(python_versions) / sizeof(python_versions[0]))
+		return result;
+
+	for (int idx = 0; idx < nr; ++idx) {
+		struct code *code = lookup_code(tgid, cfg.version, frames[idx].code);
+		int line = python_linetable_lookup(code->linetable, code->firstlineno, frames[idx].lasti);
+		result.push_back((code->filename.empty() ? "[unknown]" : code->filename) + ":" + (code->name.empty() ? "[unknown]" : code->name) + ":" +
+				 std::to_string(line));
+	}
+	return result;
+}
+
+void python_unwinder::forget(int tgid)
+{
+	codes_.erase(tgid);
+}
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_PYTHON_H
+#define HIJACK_PYTHON_H
+
+#include "hijack-common/types.h"
+#include "hijack/hijack.skel.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 根据 co_linetable 计算字节码下标对应的行号,格式与 CPython 3.11 的 Objects/locations.md 一致, 没有行号时返回 -1
+int python_linetable_lookup(const std::string &linetable, int firstlineno, int lasti);
+
+// Python 解释器栈展开. enable/disable 只修改内核中的 python_proc_map, 可以在任意线程调用;
+// symbolize/forget 在主线程调用, PyCodeObject 的符号化结果按进程缓存,两者没有共享的状态,不加锁.
+class python_unwinder {
+    public:
+	int enable(struct hijack *skel, int tgid);
+	int disable(struct hijack *skel, int tgid);
+
+	// 返回 "文件名:函数名:行号" 格式的栈帧,栈顶在前
+	std::vector<std::string> symbolize(struct hijack *skel, int tgid, const struct python_frame *frames, int nr);
+
+	// 进程退出时清理缓存,需要同时调用 disable 删除内核中的配置
+	void forget(int tgid);
+
+    private:
+	struct code {
+		std::string name;
+		std::string filename;
+		int firstlineno;
+		uint64_t linetable_addr;
+		std::string linetable;
+	};
+
+	struct code *lookup_code(int tgid, unsigned int version, uint64_t addr);
+
+	// tgid -> PyCodeObject 地址 -> 符号化结果
+	std::unordered_map<int, std::unordered_map<uint64_t, struct code>> codes_;
+};
+
+#endif
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/sched_stats.h"
+#include "hijack/metrics.h"
+#include "hijack/utils.h"
+#include <algorithm>
+#include <bpf/libbpf.h>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static const uint64_t NS_PER_SEC = 1000000000UL;
+
+int sched_stats::start(struct hijack *skel)
+{
+	skel_ = skel;
+	last_drain_ns_ = boottime_ns();
+	ncpus_ = libbpf_num_possible_cpus();
+	return ncpus_ > 0 ? 0 : -1;
+}
+
+void sched_stats::drain()
+{
+	uint64_t now = boottime_ns();
+	uint64_t elapsed = now - last_drain_ns_;
+	if (elapsed < CONFIG_SCHED_STATS_INTERVAL * NS_PER_SEC)
+		return;
+	last_drain_ns_ = now;
+
+	drain_runq_latency();
+	drain_cpu_account(elapsed);
+}
+
+void sched_stats::drain_runq_latency()
+{
+	std::vector<int> tgids;
+	std::vector<struct log2_hist> tgid_hists;
+	int ret = lookup_and_delete_all(bpf_map__fd(skel_->maps.runq_latency_tgid_map), tgids, tgid_hists, CONFIG_PROCESS_NUMBER_MAX);
+	if (ret)
+		printf("runq_latency_tgid_map lookup_and_delete_batch failed: %d\n", ret);
+
+	for (size_t idx = 0; idx < tgids.size(); ++idx) {
+		print_log2_hist("runq latency", "tgid", tgids[idx], tgid_hists[idx]);
+	}
+
+	// cgroup_id 是 cgroup 目录的 inode 编号
+	std::vector<uint64_t> cgroup_ids;
+	std::vector<struct log2_hist> cgroup_hists;
+	ret = lookup_and_delete_all(bpf_map__fd(skel_->maps.runq_latency_cgroup_map), cgroup_ids, cgroup_hists, CONFIG_CGROUP_NUMBER_MAX);
+	if (ret)
+		printf("runq_latency_cgroup_map lookup_and_delete_batch failed: %d\n", ret);
+
+	for (size_t idx = 0; idx < cgroup_ids.size(); ++idx) {
+		print_log2_hist("runq latency", "cgroup", cgroup_ids[idx], cgroup_hists[idx]);
+	}
+}
+
+// 累计值不删除,否则和内核中的累加存在竞争.线程退出后读取最后一次增量再删除
+void sched_stats::drain_cpu_account(uint64_t elapsed)
+{
+	int fd = bpf_map__fd(skel_->maps.cpu_account_map);
+	std::vector<struct cpu_account> values(ncpus_);
+	std::vector<struct cpu_account_key> exited;
+	std::map<int, struct cpu_account> tgid_deltas;
+
+	struct cpu_account_key key, next_key;
+	struct cpu_account_key *prev_key = NULL;
+	while (!bpf_map_get_next_key(fd, prev_key, &next_key)) {
+		key = next_key;
+		prev_key = &key;
+		if (bpf_map_lookup_elem(fd, &key, values.data()))
+			continue;
+
+		struct cpu_account total = {};
+		for (auto const &value : values) {
+			total.oncpu_ns += value.oncpu_ns;
+			total.voluntary += value.voluntary;
+			total.involuntary += value.involuntary;
+			total.migrations += value.migrations;
+		}
+
+		int tgid = key.tgid, pid = key.pid;
+		struct cpu_account &last = cpu_accounts_[{tgid, pid}];
+		struct cpu_account &delta = tgid_deltas[tgid];
+		delta.oncpu_ns += total.oncpu_ns - last.oncpu_ns;
+		delta.voluntary += total.voluntary - last.voluntary;
+		delta.involuntary += total.involuntary - last.involuntary;
+		delta.migrations += total.migrations - last.migrations;
+		last = total;
+
+		std::string path = "/proc/" + std::to_string(tgid) + "/task/" + std::to_string(pid);
+		if (access(path.c_str(), F_OK))
+			exited.push_back(key);
+	}
+
+	for (auto const &key : exited) {
+		int tgid = key.tgid, pid = key.pid;
+		bpf_map_delete_elem(fd, &key);
+		cpu_accounts_.erase({tgid, pid});
+	}
+
+	// 按运行时间从高到低打印
+	std::vector<std::pair<int, struct cpu_account>> top(tgid_deltas.begin(), tgid_deltas.end());
+	std::sort(top.begin(), top.end(), [](auto const &a, auto const &b) { return a.second.oncpu_ns > b.second.oncpu_ns; });
+	if (top.size() > CONFIG_CPU_ACCOUNT_TOP)
+		top.resize(CONFIG_CPU_ACCOUNT_TOP);
+
+	for (auto const &[tgid, delta] : top) {
+		printf("cpu account tgid=%d cpu=%.1f%% oncpu=%lluns voluntary=%llu involuntary=%llu migrations=%llu\n", tgid,
+		       delta.oncpu_ns * 100.0 / elapsed, delta.oncpu_ns, delta.voluntary, delta.involuntary, delta.migrations);
+	}
+}
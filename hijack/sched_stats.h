@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_SCHED_STATS_H
+#define HIJACK_SCHED_STATS_H
+
+#include "hijack-common/types.h"
+#include "hijack/hijack.skel.h"
+#include <cstdint>
+#include <map>
+#include <utility>
+
+// 定期取出内核中按进程和 cgroup 聚合的调度统计并打印.
+// 只在主线程调用,不加锁.
+class sched_stats {
+    public:
+	int start(struct hijack *skel);
+
+	// 距离上次取出超过 CONFIG_SCHED_STATS_INTERVAL 秒时执行一次
+	void drain();
+
+    private:
+	void drain_runq_latency();
+	void drain_cpu_account(uint64_t elapsed);
+
+	struct hijack *skel_;
+	uint64_t last_drain_ns_;
+	int ncpus_;
+	// cpu_account_map 中的值是累计值,保存上一次的结果计算增量
+	std::map<std::pair<int, int>, struct cpu_account> cpu_accounts_;
+};
+
+#endif
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/stack.h"
+#include "hijack-common/config.h"
+#include "hijack/metrics.h"
+#include <algorithm>
+#include <string_view>
+
+extern class metrics metrics;
+
+static uint64_t hash_bytes(const void *data, size_t len, uint64_t seed)
+{
+	uint64_t hash = std::hash<std::string_view>{}(std::string_view((const char *)data, len));
+	return hash ^ (seed + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2));
+}
+
+static void symbolize_callback(bfd_vma pc, const char *functionname, const char *filename, int line, void *data)
+{
+	std::string *name = (std::string *)data;
+	*name = std::string(functionname ? functionname : "??") + " in " + (filename ? filename : "??") + ":" + std::to_string(line);
+}
+
+struct stack_sample *stack_store::record(int kind, int tgid, struct binary *binary, const uintptr_t *ip, bool *created)
+{
+	int nr = 0;
+	while (nr < CONFIG_MAX_STACK_DEPTH && ip[nr])
+		++nr;
+
+	uint64_t seed = ((uint64_t)kind << 32) | (uint32_t)tgid;
+	uint64_t key = hash_bytes(ip, nr * sizeof(ip[0]), seed);
+
+	auto it = sample_index_.find(key);
+	if (it != sample_index_.end() && it->second->kind == kind && it->second->tgid == tgid && it->second->ip.size() == (size_t)nr &&
+	    std::equal(ip, ip + nr, it->second->ip.begin())) {
+		samples_.splice(samples_.begin(), samples_, it->second);
+		*created = false;
+		return &samples_.front();
+	}
+
+	// 极少数情况下不同的调用栈哈希值相同,丢弃旧的样本
+	if (it != sample_index_.end()) {
+		release_stack(it->second->hash);
+		samples_.erase(it->second);
+		sample_index_.erase(it);
+	}
+
+	uint64_t begin = boottime_ns();
+	uint64_t hash = intern_stack(binary, ip);
+	metrics.observe_symbolize(boottime_ns() - begin);
+
+	samples_.push_front({kind, tgid, key, hash, 0, 0, std::vector<uintptr_t>(ip, ip + nr)});
+	sample_index_[key] = samples_.begin();
+	evict();
+
+	*created = true;
+	return &samples_.front();
+}
+
+const struct stack &stack_store::lookup_stack(uint64_t hash)
+{
+	return stacks_.at(hash);
+}
+
+const std::string &stack_store::lookup_frame(uint32_t id)
+{
+	return frames_.at(id);
+}
+
+uint64_t stack_store::intern_stack(struct binary *binary, const uintptr_t *ip)
+{
+	std::vector<uint32_t> frames;
+	for (int idx = 0; idx < CONFIG_MAX_STACK_DEPTH && ip[idx]; ++idx) {
+		std::string name = "??";
+		binary_addr_to_line(binary, ip[idx], symbolize_callback, &name);
+		frames.push_back(intern_frame(name));
+	}
+
+	// 栈帧编号的哈希值冲突时线性探测,跳过占位继续查找,没有找到时复用遇到的第一个占位
+	uint64_t hash = hash_bytes(frames.data(), frames.size() * sizeof(frames[0]), 0);
+	uint64_t slot = 0;
+	bool reuse = false;
+	auto it = stacks_.find(hash);
+	while (it != stacks_.end() && (!it->second.refcnt || it->second.frames != frames)) {
+		if (!it->second.refcnt && !reuse) {
+			slot = hash;
+			reuse = true;
+		}
+		it = stacks_.find(++hash);
+	}
+
+	if (it != stacks_.end()) {
+		// 已经存在,归还本次符号化时增加的栈帧引用
+		for (uint32_t id : frames) {
+			--frame_refcnt_[id];
+		}
+		it->second.refcnt += 1;
+		return hash;
+	}
+
+	if (reuse)
+		hash = slot;
+	stacks_[hash] = {std::move(frames), 1};
+	return hash;
+}
+
+uint32_t stack_store::intern_frame(const std::string &name)
+{
+	auto it = frame_index_.find(name);
+	if (it != frame_index_.end()) {
+		frame_refcnt_[it->second] += 1;
+		return it->second;
+	}
+
+	uint32_t id;
+	if (!frame_free_.empty()) {
+		id = frame_free_.back();
+		frame_free_.pop_back();
+		frames_[id] = name;
+		frame_refcnt_[id] = 1;
+	} else {
+		id = frames_.size();
+		frames_.push_back(name);
+		frame_refcnt_.push_back(1);
+	}
+	frame_index_[name] = id;
+	return id;
+}
+
+void stack_store::release_stack(uint64_t hash)
+{
+	auto it = stacks_.find(hash);
+	if (it == stacks_.end() || !it->second.refcnt || --it->second.refcnt)
+		return;
+
+	for (uint32_t id : it->second.frames) {
+		if (--frame_refcnt_[id])
+			continue;
+		frame_index_.erase(frames_[id]);
+		frames_[id].clear();
+		frame_free_.push_back(id);
+	}
+	it->second.frames.clear();
+
+	// 后面还有探测到的调用栈时保留占位,否则连同前面相邻的占位一起删除
+	if (stacks_.count(hash + 1))
+		return;
+	stacks_.erase(it);
+	for (it = stacks_.find(--hash); it != stacks_.end() && !it->second.refcnt; it = stacks_.find(--hash)) {
+		stacks_.erase(it);
+	}
+}
+
+void stack_store::evict()
+{
+	while (samples_.size() > CONFIG_STACK_SAMPLE_MAX) {
+		struct stack_sample &sample = samples_.back();
+		release_stack(sample.hash);
+		sample_index_.erase(sample.key);
+		samples_.pop_back();
+	}
+}
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_STACK_H
+#define HIJACK_STACK_H
+
+#include "hijack-common/types.h"
+#include "hijack/binary.h"
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 符号化后的调用栈,只保存栈帧编号,内容相同的调用栈只保存一份
+struct stack {
+	std::vector<uint32_t> frames;
+	uint64_t refcnt; // 为 0 时是已经释放的占位
+};
+
+// 不对应 RB_EVENT_* 事件的样本类型,与 RB_EVENT_* 共用 kind 字段
+enum {
+	STACK_KIND_PROFILE = RB_EVENT_MAX, // 内核聚合的 offcpu/oncpu 数据,只借用调用栈表缓存符号化结果
+	STACK_KIND_WAKER,                  // offcpu 事件中唤醒者的调用栈
+};
+
+// 同一类事件在同一个进程中的调用栈及其累计值, kind 为 RB_EVENT_* 或者 STACK_KIND_*
+struct stack_sample {
+	int kind;
+	int tgid;
+	uint64_t key;
+	uint64_t hash; // 对应的 struct stack
+	uint64_t cnt;
+	uint64_t duration;
+	std::vector<uintptr_t> ip; // 原始地址,哈希值相同时用于确认是同一个调用栈
+};
+
+// 各类事件共享的调用栈表.
+// 以原始地址的哈希值查找样本,未命中时才符号化,符号化结果按栈帧内容的哈希值去重,
+// 样本数量超过上限后按最近最少使用淘汰,没有样本引用的调用栈和栈帧随之释放.
+// 调用栈的哈希值冲突时线性探测,释放后留下 refcnt 为 0 的占位,避免探测链断开.
+// 只在主线程调用,不加锁.
+class stack_store {
+    public:
+	// 返回调用栈对应的样本, created 表示本次新建, ip 以 0 结尾或者达到 CONFIG_MAX_STACK_DEPTH
+	struct stack_sample *record(int kind, int tgid, struct binary *binary, const uintptr_t *ip, bool *created);
+
+	const struct stack &lookup_stack(uint64_t hash);
+	const std::string &lookup_frame(uint32_t id);
+
+    private:
+	uint64_t intern_stack(struct binary *binary, const uintptr_t *ip);
+	uint32_t intern_frame(const std::string &name);
+	void release_stack(uint64_t hash);
+	void evict();
+
+	std::list<struct stack_sample> samples_;
+	std::unordered_map<uint64_t, std::list<struct stack_sample>::iterator> sample_index_;
+	std::unordered_map<uint64_t, struct stack> stacks_;
+
+	std::vector<std::string> frames_;
+	std::vector<uint64_t> frame_refcnt_;
+	std::vector<uint32_t> frame_free_;
+	std::unordered_map<std::string, uint32_t> frame_index_;
+};
+
+#endif
@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: Apache-2.0
+#include "hijack/stack_drainer.h"
+#include "hijack-common/types.h"
+#include "hijack/metrics.h"
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <cstring>
+#include <vector>
+
+extern class metrics metrics;
+
+static const uint64_t NS_PER_SEC = 1000000000UL;
+
+int stack_drainer::start(struct hijack *skel)
+{
+	skel_ = skel;
+	ncpus_ = libbpf_num_possible_cpus();
+	last_drain_ns_ = boottime_ns();
+	seq_ = 0;
+	return ncpus_ > 0 ? 0 : -1;
+}
+
+bool stack_drainer::due()
+{
+	return boottime_ns() - last_drain_ns_ >= CONFIG_STACK_DRAIN_INTERVAL * NS_PER_SEC;
+}
+
+void stack_drainer::drain(const std::unordered_set<uint32_t> &pinned)
+{
+	last_drain_ns_ = boottime_ns();
+
+	update_error_count();
+
+	// STACK_TRACE 类型的 map 不支持 batch 操作,先遍历出所有 key 再逐个读取和删除
+	int fd = bpf_map__fd(skel_->maps.stack_trace_map);
+	std::vector<uint32_t> keys;
+	uint32_t key, next_key;
+	uint32_t *prev = NULL;
+	while (!bpf_map_get_next_key(fd, prev, &next_key)) {
+		keys.push_back(next_key);
+		key = next_key;
+		prev = &key;
+	}
+
+	uint64_t drained = 0;
+	uintptr_t ip[CONFIG_MAX_STACK_DEPTH];
+	for (uint32_t stackid : keys) {
+		if (pinned.count(stackid) || bpf_map_lookup_elem(fd, &stackid, ip))
+			continue;
+		bpf_map_delete_elem(fd, &stackid);
+		insert(stackid, ip);
+		drained += 1;
+	}
+
+	metrics.observe_stack_drain(drained, stacks_.size());
+}
+
+int stack_drainer::lookup(uint32_t stackid, uintptr_t *ip)
+{
+	// 清理前取得的 stackid 在内核中可能已经被重新分配,优先使用清理时保存的调用栈
+	auto it = stacks_.find(stackid);
+	if (it != stacks_.end()) {
+		memcpy(ip, it->second.ip.data(), sizeof(it->second.ip));
+		touch(stackid, it->second);
+		return 0;
+	}
+
+	return bpf_map_lookup_elem(bpf_map__fd(skel_->maps.stack_trace_map), &stackid, ip) ? -1 : 0;
+}
+
+void stack_drainer::touch(uint32_t stackid, struct stack &stack)
+{
+	stack.seq = ++seq_;
+	order_.emplace_back(stackid, stack.seq);
+	compact();
+}
+
+void stack_drainer::insert(uint32_t stackid, const uintptr_t *ip)
+{
+	struct stack &stack = stacks_[stackid];
+
+	// 同一个 stackid 清理后被内核分配给了其他调用栈
+	if (stack.seq && memcmp(stack.ip.data(), ip, sizeof(stack.ip)))
+		metrics.observe_stack_collision();
+
+	memcpy(stack.ip.data(), ip, sizeof(stack.ip));
+	touch(stackid, stack);
+
+	while (stacks_.size() > CONFIG_STACK_STORE_MAX && !order_.empty()) {
+		auto [id, seq] = order_.front();
+		order_.pop_front();
+		auto it = stacks_.find(id);
+		if (it != stacks_.end() && it->second.seq == seq) {
+			stacks_.erase(it);
+			metrics.observe_stack_eviction();
+		}
+	}
+}
+
+// 覆盖写入和查询会在队列中留下作废的序号,数量过多时整理一次
+void stack_drainer::compact()
+{
+	if (order_.size() > 2 * CONFIG_STACK_STORE_MAX) {
+		std::deque<std::pair<uint32_t, uint64_t>> order;
+		for (auto &[id, seq] : order_) {
+			auto it = stacks_.find(id);
+			if (it != stacks_.end() && it->second.seq == seq)
+				order.emplace_back(id, seq);
+		}
+		order_.swap(order);
+	}
+}
+
+void stack_drainer::update_error_count()
+{
+	uint64_t total[STACK_TRACE_ERROR_MAX] = {};
+	std::vector<uint64_t> values(ncpus_);
+
+	for (int idx = 0; idx < STACK_TRACE_ERROR_MAX; ++idx) {
+		if (bpf_map_lookup_elem(bpf_map__fd(skel_->maps.stack_trace_error_map), &idx, values.data()))
+			continue;
+		for (uint64_t value : values) {
+			total[idx] += value;
+		}
+	}
+
+	metrics.observe_stackid_errors(total[STACK_TRACE_ERROR_COLLISION], total[STACK_TRACE_ERROR_OTHER]);
+}
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: Apache-2.0
+#ifndef HIJACK_STACK_DRAINER_H
+#define HIJACK_STACK_DRAINER_H
+
+#include "hijack-common/config.h"
+#include "hijack/hijack.skel.h"
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+// stack_trace_map 中的调用栈不会被内核删除,哈希桶占满后 bpf_get_stackid 只能返回 -EEXIST.
+// 在主循环中定期把调用栈搬到用户态保存并释放内核中的槽位,事件处理时先查内核再查用户态.
+// 释放后的 stackid 会被内核分配给其他调用栈,引用 stackid 的聚合结果需要在 drain 之前取出,
+// 内核中还在被引用的 stackid(常驻的内存分配统计,等待切入、解锁、唤醒时才上报的状态)在 drain 时跳过,不释放.
+// 查询时优先使用用户态保存的调用栈,内核中同一个 stackid 可能已经被分配给了其他调用栈.
+// 用户态保存的调用栈超过 CONFIG_STACK_STORE_MAX 时淘汰最久没有被查询的.
+// 只在主线程调用,不加锁.
+class stack_drainer {
+    public:
+	int start(struct hijack *skel);
+
+	// 距离上次清理超过 CONFIG_STACK_DRAIN_INTERVAL 秒
+	bool due();
+
+	// 清理一次 stack_trace_map, pinned 中的 stackid 仍被内核中的 map 引用,保留在内核中
+	void drain(const std::unordered_set<uint32_t> &pinned);
+
+	// 根据 stackid 获取调用栈,ip 至少有 CONFIG_MAX_STACK_DEPTH 个元素
+	int lookup(uint32_t stackid, uintptr_t *ip);
+
+    private:
+	struct stack {
+		std::array<uintptr_t, CONFIG_MAX_STACK_DEPTH> ip;
+		uint64_t seq;
+	};
+
+	void insert(uint32_t stackid, const uintptr_t *ip);
+	void touch(uint32_t stackid, struct stack &stack);
+	void compact();
+	void update_error_count();
+
+	struct hijack *skel_;
+	int ncpus_;
+	uint64_t last_drain_ns_;
+	uint64_t seq_;
+	std::unordered_map<uint32_t, struct stack> stacks_;
+	// 按最近写入或者查询的顺序淘汰,同一个 stackid 再次写入或者被查询后旧的序号作废
+	std::deque<std::pair<uint32_t, uint64_t>> order_;
+};
+
+#endif
@@ -1,4 +1,6 @@
 // SPDX-License-Identifier: Apache-2.0
+#include "hijack/utils.h"
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -26,3 +28,25 @@ std::string current_cgroup_mount_path()
 
 	return "";
 }
+
+// 返回分位数所在槽位的上界,即 2^(n+1) 纳秒
+uint64_t log2_hist_percentile(const struct log2_hist &hist, uint64_t percent)
+{
+	uint64_t target = (hist.count * percent + 99) / 100;
+	uint64_t total = 0;
+	for (int slot = 0; slot < CONFIG_LOG2_HIST_SLOTS; ++slot) {
+		total += hist.slots[slot];
+		if (total >= target)
+			return 1UL << (slot + 1);
+	}
+	return 1UL << CONFIG_LOG2_HIST_SLOTS;
+}
+
+void print_log2_hist(const char *name, const char *scope, uint64_t id, const struct log2_hist &hist)
+{
+	if (!hist.count)
+		return;
+
+	printf("%s %s=%lu count=%llu avg=%lluns p50<%luns p99<%luns\n", name, scope, id, hist.count, hist.sum / hist.count,
+	       log2_hist_percentile(hist, 50), log2_hist_percentile(hist, 99));
+}
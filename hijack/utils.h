@@ -1,8 +1,43 @@
 // SPDX-License-Identifier: Apache-2.0
 #ifndef HIJACK_UTILS_H
 #define HIJACK_UTILS_H
+#include "hijack-common/types.h"
+#include <bpf/bpf.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <vector>
 
 std::string current_cgroup_mount_path();
 
+// 内核中 log2_hist 的分位数估计和摘要打印, count 为 0 时不打印
+uint64_t log2_hist_percentile(const struct log2_hist &hist, uint64_t percent);
+void print_log2_hist(const char *name, const char *scope, uint64_t id, const struct log2_hist &hist);
+
+// 批量取出并删除,一次系统调用可以处理多个元素
+template <typename K, typename V> static int lookup_and_delete_all(int fd, std::vector<K> &keys, std::vector<V> &values, uint32_t max)
+{
+	keys.resize(max);
+	values.resize(max);
+
+	LIBBPF_OPTS(bpf_map_batch_opts, opts);
+	K batch;
+	uint32_t total = 0;
+	int ret = 0;
+	while (total < max) {
+		uint32_t count = max - total;
+		ret = bpf_map_lookup_and_delete_batch(fd, total ? &batch : NULL, &batch, &keys[total], &values[total], &count, &opts);
+		total += count;
+		if (ret)
+			break;
+	}
+
+	keys.resize(total);
+	values.resize(total);
+
+	// 遍历完成时返回 -ENOENT
+	return ret == -ENOENT ? 0 : ret;
+}
+
 #endif